@@ -0,0 +1,95 @@
+#include "eventloop.h"
+#include "query.h"
+#include "querytemplate.h"
+#include "atomic.h"
+#include "time.h"
+#include <gtest/gtest.h>
+#include <vector>
+#include "connection.h"
+#include "row.h"
+
+using namespace nkdhny::db;
+
+PGconn * getConnection() {
+
+        PGconn *conn = NULL;
+        conn = PQconnectdb("user=\'credentials\' password=\'credentials\' dbname=\'richquery\' hostaddr=\'127.0.0.1\' port=\'5432\' connect_timeout=5");
+        assert(conn != NULL);
+        assert(PQstatus(conn) == CONNECTION_OK);
+        return conn;
+}
+
+struct CountCompleted: public AsyncCallback {
+    volatile int completed;
+
+    CountCompleted(): completed(0) {}
+
+    void operator()(PGresult* result) {
+        if(result != NULL && PQresultStatus(result) == PGRES_TUPLES_OK) {
+            nkdhny::atomicAdd(completed, 1);
+        }
+    }
+};
+
+TEST(AsyncTest, MustReturnResultOfQuery) {
+    Connection<> c(getConnection());
+    EventLoop loop;
+
+    Query q(c, "select $1::int as _int");
+    Future f = q.pushParameter(42).sendAsync(loop);
+
+    EXPECT_EQ(f.get().begin().get<int>("_int"), 42);
+    EXPECT_TRUE(f.ready());
+    EXPECT_EQ(loop.count(), 0);
+}
+
+TEST(AsyncTest, MustRunQueriesOfManyConnectionsConcurrently) {
+    const int connections = 8;
+
+    std::vector<PGconn*> conns;
+    for(int i = 0; i < connections; i++) {
+        conns.push_back(getConnection());
+    }
+
+    EventLoop loop;
+    CountCompleted callback;
+    std::vector<Future> futures;
+
+    long start = nkdhny::gettime_ms();
+    for(int i = 0; i < connections; i++) {
+        QueryTemplate q(conns[i], "select pg_sleep(0.2), $1::int as _int");
+        futures.push_back(q.pushParameter(i).sendAsync(loop, &callback));
+    }
+
+    for(int i = 0; i < connections; i++) {
+        EXPECT_EQ(futures[i].get().begin().get<int>("_int"), i);
+    }
+    long elapsed = nkdhny::gettime_ms() - start;
+
+    EXPECT_LT(elapsed, connections*200);
+    EXPECT_EQ(nkdhny::atomicGet(callback.completed), connections);
+
+    for(int i = 0; i < connections; i++) {
+        CloseConnection()(conns[i]);
+    }
+}
+
+TEST(AsyncTest, MustLeaveConnectionUsableAfterQuery) {
+    Connection<> c(getConnection());
+
+    {
+        EventLoop loop;
+        Query q(c, "select 1::int as _int");
+        EXPECT_TRUE(q.sendAsync(loop).wait(nkdhny::gettime_ms() + 5000));
+    }
+
+    EXPECT_EQ(PQisnonblocking(c), 0);
+
+    Query q(c, "select 2::int as _int");
+    EXPECT_EQ(q().begin().get<int>("_int"), 2);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,30 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+namespace nkdhny {
+
+/** Thin wrappers over gcc atomic builtins to be used with counters shared between threads.
+  * Every function is a full memory barrier
+  */
+template <typename T>
+inline T atomicAdd(volatile T& value, T delta)
+{
+  return __sync_add_and_fetch(&value, delta);
+}
+
+template <typename T>
+inline T atomicGet(volatile T& value)
+{
+  __sync_synchronize();
+  return value;
+}
+
+template <typename T>
+inline bool atomicCompareAndSet(volatile T& value, T expected, T desired)
+{
+  return __sync_bool_compare_and_swap(&value, expected, desired);
+}
+
+}
+
+#endif // ATOMIC_H
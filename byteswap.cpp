@@ -0,0 +1,49 @@
+#include "byteswap.h"
+#include <endian.h>
+
+#if defined(__SSSE3__) && __BYTE_ORDER == __LITTLE_ENDIAN
+#include <tmmintrin.h>
+#define BYTESWAP_SSSE3
+#endif
+
+namespace nkdhny {
+namespace db {
+
+void networkToHost32(uint32_t *values, size_t count)
+{
+    size_t i = 0;
+
+#ifdef BYTESWAP_SSSE3
+    const __m128i reverse = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    for(; i + 4 <= count; i += 4) {
+        __m128i* block = reinterpret_cast<__m128i*>(values + i);
+        _mm_storeu_si128(block, _mm_shuffle_epi8(_mm_loadu_si128(block), reverse));
+    }
+#endif
+
+    for(; i < count; i++) {
+        values[i] = be32toh(values[i]);
+    }
+}
+
+void networkToHost64(uint64_t *values, size_t count)
+{
+    size_t i = 0;
+
+#ifdef BYTESWAP_SSSE3
+    const __m128i reverse = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+
+    for(; i + 2 <= count; i += 2) {
+        __m128i* block = reinterpret_cast<__m128i*>(values + i);
+        _mm_storeu_si128(block, _mm_shuffle_epi8(_mm_loadu_si128(block), reverse));
+    }
+#endif
+
+    for(; i < count; i++) {
+        values[i] = be64toh(values[i]);
+    }
+}
+
+}
+}
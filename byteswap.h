@@ -0,0 +1,20 @@
+#ifndef BYTESWAP_H
+#define BYTESWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nkdhny {
+namespace db {
+
+/** Converts `count` values from network (big endian) to host byte order in place
+  * Values are swapped 16 bytes at a time with SSSE3 shuffle if the library is built with SSSE3
+  * (see `SSSE3` build option), one by one otherwise
+  */
+void networkToHost32(uint32_t* values, size_t count);
+void networkToHost64(uint64_t* values, size_t count);
+
+}
+}
+
+#endif // BYTESWAP_H
@@ -0,0 +1,43 @@
+#include "byteswap.h"
+#include "gtest/gtest.h"
+#include <vector>
+#include <endian.h>
+
+TEST(ByteSwapTest, shouldConvert32BitValuesOfAnyCount) {
+  for(size_t count = 0; count < 11; count++) {
+    std::vector<uint32_t> values(count);
+    for(size_t i = 0; i < count; i++) {
+      values[i] = htobe32(0x01020304u + i);
+    }
+
+    if(count > 0) {
+      nkdhny::db::networkToHost32(&values[0], count);
+    }
+
+    for(size_t i = 0; i < count; i++) {
+      EXPECT_EQ(0x01020304u + i, values[i]);
+    }
+  }
+}
+
+TEST(ByteSwapTest, shouldConvert64BitValuesOfAnyCount) {
+  for(size_t count = 0; count < 7; count++) {
+    std::vector<uint64_t> values(count);
+    for(size_t i = 0; i < count; i++) {
+      values[i] = htobe64(0x0102030405060708ull + i);
+    }
+
+    if(count > 0) {
+      nkdhny::db::networkToHost64(&values[0], count);
+    }
+
+    for(size_t i = 0; i < count; i++) {
+      EXPECT_EQ(0x0102030405060708ull + i, values[i]);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
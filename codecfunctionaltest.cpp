@@ -0,0 +1,116 @@
+#include "query.h"
+#include "querytemplate.h"
+#include <gtest/gtest.h>
+#include "connection.h"
+#include "row.h"
+#include <limits>
+
+using namespace nkdhny::db;
+
+PGconn * getConnection() {
+
+        PGconn *conn = NULL;
+        conn = PQconnectdb("user=\'credentials\' password=\'credentials\' dbname=\'richquery\' hostaddr=\'127.0.0.1\' port=\'5432\' connect_timeout=5");
+        assert(conn != NULL);
+        assert(PQstatus(conn) == CONNECTION_OK);
+        return conn;
+}
+
+/** sends `value` as a parameter cast to `type` and reads it back */
+template <typename T>
+T roundTrip(PGconn* connection, const std::string& type, T value) {
+    Query q(connection, "select $1::" + type + " as _value");
+    Result r = q.pushParameter(value)();
+    return r.begin().get<T>("_value");
+}
+
+TEST(CodecTest, MustRoundTripFloats) {
+    Connection<> c(getConnection());
+
+    EXPECT_EQ(roundTrip(c, "float4", 1.5f), 1.5f);
+    EXPECT_EQ(roundTrip(c, "float4", -3.25e10f), -3.25e10f);
+    EXPECT_EQ(roundTrip(c, "float8", 0.1), 0.1);
+    EXPECT_EQ(roundTrip(c, "float8", -1e300), -1e300);
+
+    Query q(c, "select 0.5::float8 as _double, 'NaN'::float8 as _nan");
+    Result r = q();
+    EXPECT_EQ(r.begin().get<double>("_double"), 0.5);
+    EXPECT_NE(r.begin().get<double>("_nan"), r.begin().get<double>("_nan"));
+}
+
+TEST(CodecTest, MustRoundTripBool) {
+    Connection<> c(getConnection());
+
+    EXPECT_TRUE(roundTrip(c, "bool", true));
+    EXPECT_FALSE(roundTrip(c, "bool", false));
+
+    Query q(c, "select 1 < 2 as _bool");
+    EXPECT_TRUE(q().begin().get<bool>("_bool"));
+}
+
+TEST(CodecTest, MustRoundTripTimestamps) {
+    Connection<> c(getConnection());
+
+    Timestamp now(1700000000123456L);
+    EXPECT_EQ(roundTrip(c, "timestamp", now), now);
+    EXPECT_EQ(roundTrip(c, "timestamptz", now), now);
+    EXPECT_EQ(roundTrip(c, "timestamptz", Timestamp(-1)), Timestamp(-1));
+
+    Timestamp infinity(std::numeric_limits<long>::max());
+    EXPECT_EQ(roundTrip(c, "timestamptz", infinity), infinity);
+
+    Query q(c, "select '1970-01-01 00:00:01+00'::timestamptz as _unix, '2000-01-01'::timestamp as _epoch");
+    Result r = q();
+    EXPECT_EQ(r.begin().get<Timestamp>("_unix").microseconds, 1000000L);
+    EXPECT_EQ(r.begin().get<Timestamp>("_epoch").microseconds, POSTGRES_EPOCH_MICROSECONDS);
+}
+
+TEST(CodecTest, MustRoundTripNumeric) {
+    Connection<> c(getConnection());
+
+    const char* values[] = {"0", "-12.3400", "123456789012345678901234567890.000000000000000001", "0.00001", "NaN"};
+    for(size_t i = 0; i < sizeof(values)/sizeof(values[0]); i++) {
+        EXPECT_EQ(roundTrip(c, "numeric", Numeric(values[i])).value, values[i]);
+    }
+
+    Query q(c, "select 1.50::numeric(10, 3) as _numeric, (1.50::numeric(10, 3))::text as _text");
+    Result r = q();
+    EXPECT_EQ(r.begin().get<Numeric>("_numeric").value, r.begin().get<std::string>("_text"));
+}
+
+TEST(CodecTest, MustRoundTripUuid) {
+    Connection<> c(getConnection());
+
+    Uuid uuid;
+    ASSERT_TRUE(Uuid::parse("a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11", uuid));
+    EXPECT_EQ(roundTrip(c, "uuid", uuid), uuid);
+
+    Query q(c, "select $1::uuid::text as _text");
+    EXPECT_EQ(q.pushParameter(uuid)().begin().get<std::string>("_text"), uuid.str());
+}
+
+TEST(CodecTest, MustRoundTripBytea) {
+    Connection<> c(getConnection());
+
+    const char bytes[] = {0, 1, static_cast<char>(0xff), 0, 'x'};
+    Bytea value(std::string(bytes, sizeof(bytes)));
+
+    EXPECT_EQ(roundTrip(c, "bytea", value), value);
+    EXPECT_EQ(roundTrip(c, "bytea", Bytea()), Bytea());
+}
+
+TEST(CodecTest, MustCheckTypesOfPreparedStatement) {
+    Connection<> c(getConnection());
+
+    QueryTemplate q(c, "select $1::float8 + $2::float4 as _double, $3::bool as _bool, $4::numeric as _numeric");
+    Result r = q.pushParameter(1.0).pushParameter(0.5f).pushParameter(true).pushParameter(Numeric("2.5"))();
+
+    EXPECT_EQ(r.begin().get<double>("_double"), 1.5);
+    EXPECT_TRUE(r.begin().get<bool>("_bool"));
+    EXPECT_EQ(r.begin().get<Numeric>("_numeric").value, "2.5");
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
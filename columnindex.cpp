@@ -0,0 +1,66 @@
+#include "columnindex.h"
+
+namespace nkdhny {
+namespace db {
+
+ColumnIndex::ColumnIndex():
+    built(false),
+    fields(),
+    resolved()
+{}
+
+int ColumnIndex::find(const PGresult *result, const std::string &colname)
+{
+    std::map<std::string, int>::const_iterator found = resolved.find(colname);
+    if(found != resolved.end()) {
+        return found->second;
+    }
+
+    if(!built) {
+        int count = PQnfields(result);
+        for(int i = 0; i < count; i++) {
+            //the first of columns with the same name is taken
+            fields.insert(std::make_pair(std::string(PQfname(result, i)), i));
+        }
+        built = true;
+    }
+
+    int colno = -1;
+    //empty name stands for no column, `""` is to be given for column with empty name
+    if(!colname.empty()) {
+        found = fields.find(fold(colname));
+        colno = found == fields.end() ? -1 : found->second;
+    }
+
+    resolved.insert(std::make_pair(colname, colno));
+    return colno;
+}
+
+std::string ColumnIndex::fold(const std::string &colname)
+{
+    std::string folded;
+    folded.reserve(colname.size());
+
+    bool quoted = false;
+    for(size_t i = 0; i < colname.size(); i++) {
+        char c = colname[i];
+
+        if(c == '"') {
+            if(quoted && i + 1 < colname.size() && colname[i + 1] == '"') {
+                folded += '"';
+                ++i;
+            } else {
+                quoted = !quoted;
+            }
+        } else if(!quoted && c >= 'A' && c <= 'Z') {
+            folded += static_cast<char>(c + ('a' - 'A'));
+        } else {
+            folded += c;
+        }
+    }
+
+    return folded;
+}
+
+}
+}
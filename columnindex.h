@@ -0,0 +1,40 @@
+#ifndef COLUMNINDEX_H
+#define COLUMNINDEX_H
+
+#include <string>
+#include <map>
+#include <postgresql/libpq-fe.h>
+
+namespace nkdhny {
+namespace db {
+
+/** Numbers of the columns of a result by their names
+  * Names are resolved like `PQfnumber` does: unquoted parts of a name are folded to lower case (ASCII letters only),
+  * quoted parts are kept as is and `""` within quotes stands for a quote, the first matching column is taken.
+  * Index is built on the first lookup and each requested name is resolved once, thus subsequent
+  * lookups of the name do not scan the columns. Index could be shared by results with the same columns,
+  * like chunks of a `Stream`, it is not to be shared between threads
+  */
+class ColumnIndex
+{
+private:
+    bool built;
+    /** column names as given by the server */
+    std::map<std::string, int> fields;
+    /** names as requested */
+    std::map<std::string, int> resolved;
+
+public:
+    ColumnIndex();
+
+    /** number of column `colname` of `result`, -1 if there is no such column */
+    int find(const PGresult* result, const std::string& colname);
+
+    /** name of the column `colname` stands for */
+    static std::string fold(const std::string& colname);
+};
+
+}
+}
+
+#endif // COLUMNINDEX_H
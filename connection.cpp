@@ -1,10 +1,12 @@
 #include "connection.h"
+#include "statementcache.h"
 
 namespace nkdhny {
 namespace db {
 
 void CloseConnection::operator ()(PGconn *connection)
 {
+    StatementCache::purge(connection);
     PQfinish(connection);
 }
 
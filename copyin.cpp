@@ -0,0 +1,153 @@
+#include "copyin.h"
+#include <endian.h>
+#include <stdlib.h>
+
+namespace nkdhny {
+namespace db {
+
+/** signature, flags and header extension length of binary copy format */
+static const char COPY_HEADER[] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+static const size_t COPY_HEADER_SIZE = 19;
+
+CopyIn::CopyIn(PGconn *_connection, const std::string &_target, size_t _flush_size):
+    connection(_connection),
+    target(_target),
+    flush_size(_flush_size),
+    fields(),
+    buffer(),
+    started(false),
+    broken(false),
+    rows(0)
+{
+    buffer.reserve(flush_size);
+}
+
+CopyIn::~CopyIn()
+{
+    if(started) {
+        PQputCopyEnd(connection, "copy is abandoned");
+
+        PGresult* r = NULL;
+        while((r = PQgetResult(connection)) != NULL) {
+            PQclear(r);
+        }
+    }
+}
+
+void CopyIn::start()
+{
+    std::string sql = "COPY " + target + " FROM STDIN (FORMAT binary)";
+
+    PGresult* r = PQexec(connection, sql.c_str());
+    started = PQresultStatus(r) == PGRES_COPY_IN;
+    broken = !started;
+    PQclear(r);
+
+    rows = 0;
+    buffer.clear();
+
+    if(started) {
+        write(COPY_HEADER, COPY_HEADER_SIZE);
+    }
+}
+
+void CopyIn::write(const void *data, size_t size)
+{
+    const char* bytes = reinterpret_cast<const char*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void CopyIn::flush()
+{
+    if(!buffer.empty() && !broken) {
+        broken = PQputCopyData(connection, &buffer[0], buffer.size()) != 1;
+    }
+    buffer.clear();
+}
+
+CopyIn& CopyIn::endRow()
+{
+    if(!started && !broken) {
+        start();
+    }
+
+    if(broken) {
+        fields.clear();
+        return *this;
+    }
+
+    int count = fields.count();
+    const ParamBuilder::Values* values = fields.values();
+    const ParamBuilder::Sizes* sizes = fields.sizes();
+    const ParamBuilder::Formats* formats = fields.formats();
+    const Oid* types = fields.types();
+
+    //text of a value of other type, e.g. `Numeric` not encoded on the client, is not valid in binary copy
+    for(int i = 0; i < count; i++) {
+        if(formats[i] == Parameter::TEXT_FORMAT && types[i] != pgtype::UNSPECIFIED && types[i] != pgtype::TEXT) {
+            broken = true;
+            fields.clear();
+            return *this;
+        }
+    }
+
+    uint16_t field_count = htobe16(static_cast<uint16_t>(count));
+    write(&field_count, sizeof(field_count));
+
+    for(int i = 0; i < count; i++) {
+        //text parameters are terminated by zero which is not a part of the value
+        int size = formats[i] == Parameter::TEXT_FORMAT ? sizes[i] - 1 : sizes[i];
+
+        uint32_t length = htobe32(static_cast<uint32_t>(size));
+        write(&length, sizeof(length));
+        write(values[i], size);
+    }
+
+    fields.clear();
+    ++rows;
+
+    if(buffer.size() >= flush_size) {
+        flush();
+    }
+
+    return *this;
+}
+
+long CopyIn::operator ()()
+{
+    if(!started && !broken) {
+        start();
+    }
+
+    long copied = -1;
+
+    if(started) {
+        uint16_t trailer = htobe16(static_cast<uint16_t>(-1));
+        write(&trailer, sizeof(trailer));
+        flush();
+
+        started = false;
+        if(PQputCopyEnd(connection, broken ? "copy is broken" : NULL) == 1) {
+            PGresult* r = NULL;
+            while((r = PQgetResult(connection)) != NULL) {
+                if(PQresultStatus(r) == PGRES_COMMAND_OK && !broken) {
+                    copied = atol(PQcmdTuples(r));
+                }
+                PQclear(r);
+            }
+        }
+    }
+
+    broken = false;
+    rows = 0;
+
+    return copied;
+}
+
+long CopyIn::count()
+{
+    return rows;
+}
+
+}
+}
@@ -0,0 +1,86 @@
+#ifndef COPYIN_H
+#define COPYIN_H
+
+#include <string>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+#include "parambuilder.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Bulk loader of rows into a table with `COPY ... FROM STDIN (FORMAT binary)`
+  * @verbatim
+  *     CopyIn copy(connection, "foo (id, name)");
+  *     copy.push(1).push(std::string("first")).endRow();
+  *     copy.push(2).push(std::string("second")).endRow();
+  *     long copied = copy();
+  * @endverbatim
+  * Fields are encoded by `ParamBuilder::push`, thus each type which is pushed in binary representation
+  * (see `ParamBuilder::push`) could be a field of the column of the corresponding type. Text fields (`std::string`
+  * and `char*`) are written as is without the terminating zero, which is the binary representation of text columns only
+  * (`text`, `varchar`, `char`), e.g. a number given as text is not valid for a numeric column.
+  * Field pushed as text of other type (see `Numeric`) breaks the copy, no row is copied then.
+  * Rows are buffered and sent with `PQputCopyData` once the buffer holds `flush_size` bytes,
+  * the copy is started by the first row and is finished by `operator()`.
+  *
+  * Connection is not to be used by other queries until the copy is finished,
+  * loader destroyed before the copy is finished aborts it, no row is copied then.
+  * Loader is not copyable and is not to be shared between threads
+  */
+class CopyIn
+{
+private:
+    static const size_t DEFAULT_FLUSH_SIZE = 64*1024;
+
+    PGconn* connection;
+    std::string target;
+    size_t flush_size;
+
+    /** fields of the row being built */
+    ParamBuilder fields;
+    /** rows encoded but not sent yet */
+    std::vector<char> buffer;
+
+    bool started;
+    bool broken;
+    long rows;
+
+    CopyIn(const CopyIn&);
+    const CopyIn& operator =(const CopyIn&);
+
+    void start();
+    void write(const void* data, size_t size);
+    void flush();
+
+public:
+    /** `_target` is a table name optionally followed by the list of columns, like `foo (id, name)` */
+    CopyIn(PGconn* _connection, const std::string& _target, size_t _flush_size = DEFAULT_FLUSH_SIZE);
+    /** aborts the copy if it is not finished */
+    ~CopyIn();
+
+    /** @brief appends field of type `T` with value `value` to the current row (see `ParamBuilder::push`) */
+    template <typename T>
+    CopyIn& push(T value);
+
+    /** ends the current row, the row is sent with subsequent ones */
+    CopyIn& endRow();
+
+    /** sends the rows left and finishes the copy, returns count of rows copied
+      * or -1 if the copy failed, loader could be used once more after that */
+    long operator()();
+
+    /** count of rows ended so far */
+    long count();
+};
+
+template <typename T>
+CopyIn& CopyIn::push(T value) {
+    fields.push<T>(value);
+    return *this;
+}
+
+}
+}
+
+#endif // COPYIN_H
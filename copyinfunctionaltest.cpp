@@ -0,0 +1,93 @@
+#include "copyin.h"
+#include "querytemplate.h"
+#include <gtest/gtest.h>
+#include "connection.h"
+#include "row.h"
+
+using namespace nkdhny::db;
+
+PGconn * getConnection() {
+
+        PGconn *conn = NULL;
+        conn = PQconnectdb("user=\'credentials\' password=\'credentials\' dbname=\'richquery\' hostaddr=\'127.0.0.1\' port=\'5432\' connect_timeout=5");
+        assert(conn != NULL);
+        assert(PQstatus(conn) == CONNECTION_OK);
+        return conn;
+}
+
+TEST(CopyInTest, MustCopyAllRows) {
+    Connection<> c(getConnection());
+    QueryTemplate create(c, "create table t(i int, l bigint, s text);");
+    create();
+
+    {
+        CopyIn copy(c, "t (i, l, s)");
+        for(int i = 0; i < 100000; i++) {
+            copy.push(i).push(static_cast<long>(i)*1000000000L).push(std::string("row")).endRow();
+        }
+
+        EXPECT_EQ(copy.count(), 100000);
+        EXPECT_EQ(copy(), 100000);
+    }
+
+    QueryTemplate select(c, "select count(*)::int as _int, max(l) as _long, min(s) as _text from t;");
+    Result r = select();
+    Row row = r.begin();
+    EXPECT_EQ(row.get<int>("_int"), 100000);
+    EXPECT_EQ(row.get<long>("_long"), 99999L*1000000000L);
+    EXPECT_EQ(row.get<std::string>("_text"), "row");
+
+    QueryTemplate drop(c, "drop table t;");
+    drop();
+}
+
+TEST(CopyInTest, MustCopyNothingIfAbandoned) {
+    Connection<> c(getConnection());
+    QueryTemplate create(c, "create table t(i int);");
+    create();
+
+    {
+        CopyIn copy(c, "t");
+        copy.push(1).endRow();
+    }
+
+    QueryTemplate select(c, "select count(*)::int as _int from t;");
+    EXPECT_EQ(select().begin().get<int>("_int"), 0);
+
+    QueryTemplate drop(c, "drop table t;");
+    drop();
+}
+
+TEST(CopyInTest, MustFailOnMissingTable) {
+    Connection<> c(getConnection());
+
+    CopyIn copy(c, "no_such_table");
+    copy.push(1).endRow();
+
+    EXPECT_EQ(copy(), -1);
+}
+
+TEST(CopyInTest, MustFailOnNumericGivenAsText) {
+    Connection<> c(getConnection());
+    QueryTemplate create(c, "create table t(n numeric);");
+    create();
+
+    {
+        CopyIn copy(c, "t");
+        copy.push(Numeric("1.5")).endRow();
+        copy.push(Numeric("1e5")).endRow();
+
+        EXPECT_EQ(copy(), -1);
+    }
+
+    QueryTemplate count(c, "select count(*)::int as _int from t;");
+    EXPECT_EQ(count().begin().get<int>("_int"), 0);
+
+    QueryTemplate drop(c, "drop table t;");
+    drop();
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,261 @@
+#include "copyout.h"
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace nkdhny {
+namespace db {
+
+/** signature, flags and header extension length of binary copy format */
+static const char COPY_SIGNATURE[] = "PGCOPY\n\377\r\n";
+static const int COPY_SIGNATURE_SIZE = 11;
+static const int COPY_HEADER_SIZE = COPY_SIGNATURE_SIZE + 2*sizeof(uint32_t);
+
+static inline uint16_t readUint16(const char* data) {
+    uint16_t value;
+    memcpy(&value, data, sizeof(value));
+    return be16toh(value);
+}
+
+static inline uint32_t readUint32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return be32toh(value);
+}
+
+int CopyRow::count()
+{
+    return values.size();
+}
+
+bool CopyRow::isNull(int colno)
+{
+    assert(colno < count());
+    return values[colno] == NULL;
+}
+
+template <>
+int CopyRow::get<int>(int colno) {
+    assert(colno < count());
+    assert(sizes[colno] == sizeof(uint32_t));
+    return static_cast<int>(readUint32(values[colno]));
+}
+
+template <>
+unsigned CopyRow::get<unsigned>(int colno) {
+    return static_cast<unsigned>(get<int>(colno));
+}
+
+template <>
+long CopyRow::get<long>(int colno) {
+    assert(colno < count());
+    assert(sizes[colno] == sizeof(uint64_t));
+
+    uint64_t value;
+    memcpy(&value, values[colno], sizeof(value));
+    return static_cast<long>(be64toh(value));
+}
+
+template <>
+unsigned long CopyRow::get<unsigned long>(int colno) {
+    return static_cast<unsigned long>(get<long>(colno));
+}
+
+template <>
+std::string CopyRow::get<std::string>(int colno) {
+    assert(colno < count());
+    return values[colno] == NULL ? std::string() : std::string(values[colno], sizes[colno]);
+}
+
+template <>
+Span CopyRow::get<Span>(int colno) {
+    assert(colno < count());
+    return values[colno] == NULL ? Span() : Span(values[colno], sizes[colno]);
+}
+
+CopyOut::CopyOut(PGconn *_connection, const std::string &_source):
+    connection(_connection),
+    source(_source),
+    started(false),
+    finished(false),
+    header(false),
+    failed(false),
+    rows(0),
+    buffer(NULL),
+    current()
+{}
+
+CopyOut::~CopyOut()
+{
+    release();
+
+    if(started && !finished) {
+        cancel();
+    }
+}
+
+void CopyOut::cancel()
+{
+    //the rest of the rows is not to be transfered
+    PGcancel* request = PQgetCancel(connection);
+    if(request != NULL) {
+        char error[256];
+        PQcancel(request, error, sizeof(error));
+        PQfreeCancel(request);
+    }
+
+    char* data = NULL;
+    while(PQgetCopyData(connection, &data, 0) > 0) {
+        PQfreemem(data);
+    }
+    finish();
+}
+
+void CopyOut::start()
+{
+    started = true;
+
+    std::string sql = "COPY " + source + " TO STDOUT (FORMAT binary)";
+
+    PGresult* r = PQexec(connection, sql.c_str());
+    bool copying = PQresultStatus(r) == PGRES_COPY_OUT;
+    PQclear(r);
+
+    if(!copying) {
+        failed = true;
+        finished = true;
+    }
+}
+
+void CopyOut::finish()
+{
+    finished = true;
+
+    PGresult* r = NULL;
+    while((r = PQgetResult(connection)) != NULL) {
+        if(PQresultStatus(r) != PGRES_COMMAND_OK) {
+            failed = true;
+        }
+        PQclear(r);
+    }
+}
+
+void CopyOut::release()
+{
+    if(buffer != NULL) {
+        PQfreemem(buffer);
+        buffer = NULL;
+    }
+}
+
+bool CopyOut::parse(const char *data, int size)
+{
+    const char* end = data + size;
+
+    //header is sent with the first row
+    if(!header) {
+        if(size < COPY_HEADER_SIZE || memcmp(data, COPY_SIGNATURE, COPY_SIGNATURE_SIZE) != 0) {
+            failed = true;
+            return false;
+        }
+        uint32_t extension = readUint32(data + COPY_SIGNATURE_SIZE + sizeof(uint32_t));
+        data += COPY_HEADER_SIZE + extension;
+        header = true;
+    }
+
+    if(end - data < static_cast<int>(sizeof(uint16_t))) {
+        failed = true;
+        return false;
+    }
+
+    int16_t fields = static_cast<int16_t>(readUint16(data));
+    data += sizeof(uint16_t);
+
+    //trailer
+    if(fields < 0) {
+        return false;
+    }
+
+    current.values.resize(fields);
+    current.sizes.resize(fields);
+
+    for(int i = 0; i < fields; i++) {
+        if(end - data < static_cast<int>(sizeof(uint32_t))) {
+            failed = true;
+            return false;
+        }
+
+        int32_t length = static_cast<int32_t>(readUint32(data));
+        data += sizeof(uint32_t);
+
+        if(length < 0) {
+            current.values[i] = NULL;
+            current.sizes[i] = 0;
+            continue;
+        }
+
+        if(end - data < length) {
+            failed = true;
+            return false;
+        }
+
+        current.values[i] = data;
+        current.sizes[i] = length;
+        data += length;
+    }
+
+    return true;
+}
+
+bool CopyOut::next()
+{
+    if(!started) {
+        start();
+    }
+
+    release();
+
+    while(!finished) {
+        //libpq gives a single row at a time
+        int size = PQgetCopyData(connection, &buffer, 0);
+
+        if(size < 0) {
+            failed = failed || size == -2;
+            finish();
+            break;
+        }
+
+        if(parse(buffer, size)) {
+            ++rows;
+            return true;
+        }
+
+        release();
+
+        //rows after a malformed one are not read
+        if(failed) {
+            cancel();
+        }
+    }
+
+    return false;
+}
+
+CopyRow& CopyOut::row()
+{
+    assert(buffer != NULL);
+    return current;
+}
+
+long CopyOut::count()
+{
+    return rows;
+}
+
+bool CopyOut::succeeded()
+{
+    return finished && !failed;
+}
+
+}
+}
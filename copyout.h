@@ -0,0 +1,98 @@
+#ifndef COPYOUT_H
+#define COPYOUT_H
+
+#include <string>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+#include "assert.h"
+#include "span.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Row of a binary copy, its fields point into the data received from the server
+  * thus nothing is allocated to read a field, except for `std::string` itself.
+  * Row is valid until the next row is read */
+struct CopyRow {
+    /** start of each field, `NULL` if the field is null */
+    std::vector<const char*> values;
+    std::vector<int> sizes;
+
+    /** count of fields in a row */
+    int count();
+
+    bool isNull(int colno);
+
+    /** Typed get of the field binary representation, like `Row::get`,
+      * `Span` of a field points into the row thus it is valid until the next row is read */
+    template <typename _T>
+    _T get(int colno);
+};
+
+/** Bulk reader of a table or a query result with `COPY ... TO STDOUT (FORMAT binary)`
+  * @verbatim
+  *     CopyOut copy(connection, "foo (id, name)");
+  *     while(copy.next()) {
+  *         CopyRow& r = copy.row();
+  *         r.get<int>(0);
+  *         r.get<std::string>(1);
+  *     }
+  * @endverbatim
+  * Rows are parsed one by one as they are received, thus only the current row is kept in memory.
+  * Connection is not to be used by other queries until all rows are read or the reader is destroyed,
+  * reader destroyed before the last row is read cancels the copy.
+  * Reader is not copyable and is not to be shared between threads
+  */
+class CopyOut
+{
+private:
+    PGconn* connection;
+    std::string source;
+
+    bool started;
+    bool finished;
+    bool header;
+    bool failed;
+    long rows;
+
+    /** data of the current row as received from libpq */
+    char* buffer;
+    CopyRow current;
+
+    CopyOut(const CopyOut&);
+    const CopyOut& operator =(const CopyOut&);
+
+    void start();
+    void finish();
+    /** stops the copy before all rows are read and finishes it */
+    void cancel();
+    void release();
+    /** parses a row from `size` bytes of `data`, returns false if data is the trailer or is malformed, the latter fails the copy */
+    bool parse(const char* data, int size);
+
+public:
+    /** `_source` is a table name optionally followed by the list of columns, like `foo (id, name)`,
+      * or a query in parentheses */
+    CopyOut(PGconn* _connection, const std::string& _source);
+    /** cancels the copy if not all rows are read */
+    ~CopyOut();
+
+    /** reads the next row, the copy is started on the first call,
+      * returns false if there are no more rows or the copy failed (see `succeeded`),
+      * no row is read after a malformed one */
+    bool next();
+
+    /** current row */
+    CopyRow& row();
+
+    /** count of rows read so far */
+    long count();
+
+    /** true if all rows are read and the copy succeeded */
+    bool succeeded();
+};
+
+}
+}
+
+#endif // COPYOUT_H
@@ -0,0 +1,95 @@
+#include "copyout.h"
+#include "copyin.h"
+#include "querytemplate.h"
+#include <gtest/gtest.h>
+#include "connection.h"
+#include "row.h"
+#include <sstream>
+
+using namespace nkdhny::db;
+
+PGconn * getConnection() {
+
+        PGconn *conn = NULL;
+        conn = PQconnectdb("user=\'credentials\' password=\'credentials\' dbname=\'richquery\' hostaddr=\'127.0.0.1\' port=\'5432\' connect_timeout=5");
+        assert(conn != NULL);
+        assert(PQstatus(conn) == CONNECTION_OK);
+        return conn;
+}
+
+TEST(CopyOutTest, MustReadTypedFields) {
+    Connection<> c(getConnection());
+    CopyOut copy(c, "(select i::int, i::bigint*1000000000, 'row' || i, null::text from generate_series(1, 10000) as i)");
+
+    int expected = 0;
+    while(copy.next()) {
+        ++expected;
+        CopyRow& r = copy.row();
+
+        EXPECT_EQ(r.count(), 4);
+        EXPECT_EQ(r.get<int>(0), expected);
+        EXPECT_EQ(r.get<long>(1), expected*1000000000L);
+        std::ostringstream text;
+        text << "row" << expected;
+        EXPECT_EQ(r.get<std::string>(2), text.str());
+        EXPECT_TRUE(r.isNull(3));
+    }
+
+    EXPECT_EQ(expected, 10000);
+    EXPECT_EQ(copy.count(), 10000);
+    EXPECT_TRUE(copy.succeeded());
+}
+
+TEST(CopyOutTest, MustReadWhatWasCopiedIn) {
+    Connection<> c(getConnection());
+    QueryTemplate create(c, "create table t(i int, s text);");
+    create();
+
+    {
+        CopyIn in(c, "t (i, s)");
+        for(int i = 0; i < 1000; i++) {
+            in.push(i).push(std::string("text")).endRow();
+        }
+        EXPECT_EQ(in(), 1000);
+    }
+
+    {
+        CopyOut out(c, "t (s, i)");
+        long sum = 0;
+        while(out.next()) {
+            EXPECT_EQ(out.row().get<std::string>(0), "text");
+            sum += out.row().get<int>(1);
+        }
+        EXPECT_EQ(sum, 999*1000/2);
+        EXPECT_TRUE(out.succeeded());
+    }
+
+    QueryTemplate drop(c, "drop table t;");
+    drop();
+}
+
+TEST(CopyOutTest, MustLeaveConnectionUsableWhenStoppedEarly) {
+    Connection<> c(getConnection());
+
+    {
+        CopyOut copy(c, "(select i::int from generate_series(1, 10000000) as i)");
+        EXPECT_TRUE(copy.next());
+        EXPECT_EQ(copy.row().get<int>(0), 1);
+    }
+
+    QueryTemplate q(c, "select 2::int as _int");
+    EXPECT_EQ(q().begin().get<int>("_int"), 2);
+}
+
+TEST(CopyOutTest, MustFailOnMissingTable) {
+    Connection<> c(getConnection());
+    CopyOut copy(c, "no_such_table");
+
+    EXPECT_FALSE(copy.next());
+    EXPECT_FALSE(copy.succeeded());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,166 @@
+#include "copyout.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <sstream>
+#include <endian.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace nkdhny::db;
+
+/** server side of a connection which answers any query with a binary copy of given rows,
+  * it speaks just enough of the protocol for libpq to connect and to read the copy */
+struct FakeServer {
+  int listener;
+  int port;
+  /** data of each CopyData message, the first one starts with the copy header */
+  std::vector<std::string> messages;
+  pthread_t thread;
+
+  FakeServer(): listener(-1), port(0), messages() {}
+};
+
+static std::string uint16(uint16_t value) {
+  value = htobe16(value);
+  return std::string(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static std::string uint32(uint32_t value) {
+  value = htobe32(value);
+  return std::string(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static std::string message(char type, const std::string& body) {
+  return std::string(1, type) + uint32(body.size() + sizeof(uint32_t)) + body;
+}
+
+static bool readFully(int fd, char* data, size_t size) {
+  while(size > 0) {
+    ssize_t got = read(fd, data, size);
+    if(got <= 0) {
+      return false;
+    }
+    data += got;
+    size -= got;
+  }
+  return true;
+}
+
+/** skips a message, the startup one has no type */
+static bool skip(int fd, bool typed) {
+  char type;
+  if(typed && !readFully(fd, &type, 1)) {
+    return false;
+  }
+
+  uint32_t length;
+  if(!readFully(fd, reinterpret_cast<char*>(&length), sizeof(length))) {
+    return false;
+  }
+
+  std::string body(be32toh(length) - sizeof(length), '\0');
+  return readFully(fd, &body[0], body.size());
+}
+
+static void* serve(void* arg) {
+  FakeServer* server = reinterpret_cast<FakeServer*>(arg);
+
+  int peer = accept(server->listener, NULL, NULL);
+  //cancel request is refused
+  close(server->listener);
+  if(peer < 0) {
+    return NULL;
+  }
+
+  std::string reply;
+  if(skip(peer, false)) {
+    reply = message('R', uint32(0)) + message('Z', "I");
+    write(peer, reply.data(), reply.size());
+  }
+
+  if(skip(peer, true)) {
+    //binary copy of a single column
+    reply = message('H', std::string(1, '\1') + uint16(1) + uint16(1));
+    for(size_t i = 0; i < server->messages.size(); i++) {
+      reply += message('d', server->messages[i]);
+    }
+    std::ostringstream tag;
+    tag << "COPY " << server->messages.size() - 1;
+    reply += message('c', "") + message('C', tag.str() + std::string(1, '\0')) + message('Z', "I");
+    write(peer, reply.data(), reply.size());
+  }
+
+  char rest;
+  while(read(peer, &rest, 1) > 0) {}
+  close(peer);
+
+  return NULL;
+}
+
+static void start(FakeServer& server) {
+  server.listener = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(server.listener, 0);
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  ASSERT_EQ(0, bind(server.listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+  ASSERT_EQ(0, listen(server.listener, 1));
+
+  socklen_t size = sizeof(address);
+  ASSERT_EQ(0, getsockname(server.listener, reinterpret_cast<sockaddr*>(&address), &size));
+  server.port = ntohs(address.sin_port);
+
+  ASSERT_EQ(0, pthread_create(&server.thread, NULL, serve, &server));
+}
+
+static PGconn* connect(FakeServer& server) {
+  std::ostringstream conninfo;
+  conninfo << "hostaddr=127.0.0.1 port=" << server.port << " user=fake dbname=fake sslmode=disable gssencmode=disable connect_timeout=5";
+  return PQconnectdb(conninfo.str().c_str());
+}
+
+static std::string row(int value) {
+  return uint16(1) + uint32(sizeof(uint32_t)) + uint32(value);
+}
+
+TEST(CopyOutTest, shouldStopAtMalformedRow) {
+  FakeServer server;
+
+  const char signature[] = "PGCOPY\n\377\r\n";
+  std::string header = std::string(signature, sizeof(signature)) + uint32(0) + uint32(0);
+  server.messages.push_back(header + row(1));
+  //field is said to be longer than the row
+  server.messages.push_back(uint16(1) + uint32(100) + uint32(2));
+  server.messages.push_back(row(3));
+  server.messages.push_back(uint16(0xffff));
+
+  start(server);
+  PGconn* connection = connect(server);
+  ASSERT_EQ(CONNECTION_OK, PQstatus(connection)) << PQerrorMessage(connection);
+
+  {
+    CopyOut copy(connection, "foo");
+
+    ASSERT_TRUE(copy.next());
+    EXPECT_EQ(1, copy.row().get<int>(0));
+
+    EXPECT_FALSE(copy.next());
+    EXPECT_FALSE(copy.next());
+    EXPECT_EQ(1, copy.count());
+    EXPECT_FALSE(copy.succeeded());
+  }
+
+  PQfinish(connection);
+  pthread_join(server.thread, NULL);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
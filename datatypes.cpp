@@ -0,0 +1,248 @@
+#include "datatypes.h"
+#include <endian.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <limits>
+
+namespace nkdhny {
+namespace db {
+
+/** sign field of binary numeric */
+static const uint16_t NUMERIC_POSITIVE = 0x0000;
+static const uint16_t NUMERIC_NEGATIVE = 0x4000;
+static const uint16_t NUMERIC_NAN = 0xC000;
+static const uint16_t NUMERIC_PINF = 0xD000;
+static const uint16_t NUMERIC_NINF = 0xF000;
+/** numeric digits are base 10000 */
+static const int NUMERIC_DIGIT_SIZE = 4;
+
+long toServerEpoch(const Timestamp &timestamp)
+{
+    long us = timestamp.microseconds;
+    if(us == std::numeric_limits<long>::max() || us == std::numeric_limits<long>::min()) {
+        return us;
+    }
+    return us - POSTGRES_EPOCH_MICROSECONDS;
+}
+
+Timestamp fromServerEpoch(long microseconds)
+{
+    if(microseconds == std::numeric_limits<long>::max() || microseconds == std::numeric_limits<long>::min()) {
+        return Timestamp(microseconds);
+    }
+    return Timestamp(microseconds + POSTGRES_EPOCH_MICROSECONDS);
+}
+
+static int hexDigit(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool Uuid::parse(const std::string &text, Uuid &uuid)
+{
+    size_t byte = 0;
+
+    for(size_t i = 0; i < text.size(); i++) {
+        if(text[i] == '-') {
+            continue;
+        }
+
+        int high = hexDigit(text[i]);
+        int low = i + 1 < text.size() ? hexDigit(text[i + 1]) : -1;
+        if(high < 0 || low < 0 || byte == sizeof(uuid.bytes)) {
+            return false;
+        }
+
+        uuid.bytes[byte++] = static_cast<unsigned char>(high << 4 | low);
+        ++i;
+    }
+
+    return byte == sizeof(uuid.bytes);
+}
+
+std::string Uuid::str() const
+{
+    char text[37];
+    snprintf(text, sizeof(text), "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+             bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5], bytes[6], bytes[7],
+             bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13], bytes[14], bytes[15]);
+    return std::string(text);
+}
+
+static void appendUint16(std::string& binary, uint16_t value) {
+    value = htobe16(value);
+    binary.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void encodeSpecialNumeric(std::string& binary, uint16_t sign) {
+    binary.clear();
+    appendUint16(binary, 0);
+    appendUint16(binary, 0);
+    appendUint16(binary, sign);
+    appendUint16(binary, 0);
+}
+
+bool encodeNumeric(const std::string &value, std::string &binary)
+{
+    if(value == "NaN") {
+        encodeSpecialNumeric(binary, NUMERIC_NAN);
+        return true;
+    }
+    if(value == "Infinity" || value == "+Infinity") {
+        encodeSpecialNumeric(binary, NUMERIC_PINF);
+        return true;
+    }
+    if(value == "-Infinity") {
+        encodeSpecialNumeric(binary, NUMERIC_NINF);
+        return true;
+    }
+
+    size_t i = 0;
+    uint16_t sign = NUMERIC_POSITIVE;
+    if(i < value.size() && (value[i] == '-' || value[i] == '+')) {
+        sign = value[i] == '-' ? NUMERIC_NEGATIVE : NUMERIC_POSITIVE;
+        ++i;
+    }
+
+    std::string integral;
+    std::string fraction;
+    bool point = false;
+
+    for(; i < value.size(); i++) {
+        char c = value[i];
+        if(c == '.' && !point) {
+            point = true;
+        } else if(c >= '0' && c <= '9') {
+            (point ? fraction : integral) += c;
+        } else {
+            return false;
+        }
+    }
+
+    if(integral.empty() && fraction.empty()) {
+        return false;
+    }
+
+    int dscale = fraction.size();
+
+    //decimal digits aligned to groups of base 10000 digits around the point
+    size_t leading = (NUMERIC_DIGIT_SIZE - integral.size() % NUMERIC_DIGIT_SIZE) % NUMERIC_DIGIT_SIZE;
+    size_t trailing = (NUMERIC_DIGIT_SIZE - fraction.size() % NUMERIC_DIGIT_SIZE) % NUMERIC_DIGIT_SIZE;
+    std::string aligned = std::string(leading, '0') + integral + fraction + std::string(trailing, '0');
+
+    std::vector<uint16_t> digits;
+    for(size_t d = 0; d < aligned.size(); d += NUMERIC_DIGIT_SIZE) {
+        uint16_t digit = 0;
+        for(int k = 0; k < NUMERIC_DIGIT_SIZE; k++) {
+            digit = digit*10 + (aligned[d + k] - '0');
+        }
+        digits.push_back(digit);
+    }
+
+    int weight = static_cast<int>((leading + integral.size()) / NUMERIC_DIGIT_SIZE) - 1;
+
+    //zero digits at both ends are implied by weight and count of digits
+    size_t first = 0;
+    while(first < digits.size() && digits[first] == 0) {
+        ++first;
+        --weight;
+    }
+    size_t last = digits.size();
+    while(last > first && digits[last - 1] == 0) {
+        --last;
+    }
+
+    if(first == last) {
+        weight = 0;
+        sign = NUMERIC_POSITIVE;
+    }
+
+    binary.clear();
+    appendUint16(binary, static_cast<uint16_t>(last - first));
+    appendUint16(binary, static_cast<uint16_t>(static_cast<int16_t>(weight)));
+    appendUint16(binary, sign);
+    appendUint16(binary, static_cast<uint16_t>(dscale));
+    for(size_t d = first; d < last; d++) {
+        appendUint16(binary, digits[d]);
+    }
+
+    return true;
+}
+
+static uint16_t readUint16(const char* binary) {
+    uint16_t value;
+    memcpy(&value, binary, sizeof(value));
+    return be16toh(value);
+}
+
+std::string decodeNumeric(const char *binary, int size)
+{
+    if(size < static_cast<int>(4*sizeof(uint16_t))) {
+        return std::string();
+    }
+
+    int ndigits = readUint16(binary);
+    int weight = static_cast<int16_t>(readUint16(binary + 2));
+    uint16_t sign = readUint16(binary + 4);
+    int dscale = readUint16(binary + 6);
+    const char* digits = binary + 8;
+
+    if(sign == NUMERIC_NAN) {
+        return "NaN";
+    }
+    if(sign == NUMERIC_PINF) {
+        return "Infinity";
+    }
+    if(sign == NUMERIC_NINF) {
+        return "-Infinity";
+    }
+
+    if(size < static_cast<int>((4 + ndigits)*sizeof(uint16_t))) {
+        return std::string();
+    }
+
+    std::string value;
+    if(sign == NUMERIC_NEGATIVE) {
+        value += '-';
+    }
+
+    char group[8];
+
+    //integral part, digits of weight `weight` down to 0
+    if(weight < 0) {
+        value += '0';
+    }
+    for(int w = weight; w >= 0; w--) {
+        int d = weight - w;
+        int digit = d < ndigits ? readUint16(digits + d*sizeof(uint16_t)) : 0;
+        snprintf(group, sizeof(group), w == weight ? "%d" : "%04d", digit);
+        value += group;
+    }
+
+    //fraction part, digits of weight -1 and lower up to `dscale` decimal digits
+    if(dscale > 0) {
+        std::string fraction;
+        for(int w = -1; static_cast<int>(fraction.size()) < dscale; w--) {
+            int d = weight - w;
+            int digit = d >= 0 && d < ndigits ? readUint16(digits + d*sizeof(uint16_t)) : 0;
+            snprintf(group, sizeof(group), "%04d", digit);
+            fraction += group;
+        }
+        value += '.';
+        value += fraction.substr(0, dscale);
+    }
+
+    return value;
+}
+
+}
+}
@@ -0,0 +1,85 @@
+#ifndef DATATYPES_H
+#define DATATYPES_H
+
+#include <string>
+#include <string.h>
+
+namespace nkdhny {
+namespace db {
+
+/** `timestamp` or `timestamptz` value as microseconds since Unix epoch, in UTC for `timestamptz`
+  * Both types share binary representation, thus `Timestamp` parameter is of the type the server infers
+  * (like `$1::timestamptz`). Infinite timestamps are the least and the greatest `long` values
+  */
+struct Timestamp {
+    long microseconds;
+
+    Timestamp(): microseconds(0) {}
+    explicit Timestamp(long _microseconds): microseconds(_microseconds) {}
+
+    bool operator ==(const Timestamp& other) const {
+        return microseconds == other.microseconds;
+    }
+};
+
+/** `numeric` value as its decimal representation like `-12.3400`, `NaN`, `Infinity` or `-Infinity`
+  * Value is converted to and from binary representation on the client, thus its precision is kept
+  */
+struct Numeric {
+    std::string value;
+
+    Numeric(): value("0") {}
+    explicit Numeric(const std::string& _value): value(_value) {}
+
+    bool operator ==(const Numeric& other) const {
+        return value == other.value;
+    }
+};
+
+/** `uuid` value as its 16 bytes */
+struct Uuid {
+    unsigned char bytes[16];
+
+    Uuid() {
+        memset(bytes, 0, sizeof(bytes));
+    }
+
+    bool operator ==(const Uuid& other) const {
+        return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+    }
+
+    /** parses canonical form like `a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11`, dashes are optional,
+      * returns false if `text` is not a uuid */
+    static bool parse(const std::string& text, Uuid& uuid);
+    /** canonical form */
+    std::string str() const;
+};
+
+/** `bytea` value, unlike `std::string` parameter it could hold zero bytes */
+struct Bytea {
+    std::string bytes;
+
+    Bytea(): bytes() {}
+    explicit Bytea(const std::string& _bytes): bytes(_bytes) {}
+
+    bool operator ==(const Bytea& other) const {
+        return bytes == other.bytes;
+    }
+};
+
+/** binary representation of numeric `value` (see `Numeric`), returns false if value is not a number */
+bool encodeNumeric(const std::string& value, std::string& binary);
+/** decimal representation of `size` bytes of binary numeric */
+std::string decodeNumeric(const char* binary, int size);
+
+/** microseconds between Unix epoch and server epoch 2000-01-01 */
+const long POSTGRES_EPOCH_MICROSECONDS = 946684800000000L;
+
+/** microseconds since server epoch as sent by the server for `timestamp`, infinite values are kept as is */
+long toServerEpoch(const Timestamp& timestamp);
+Timestamp fromServerEpoch(long microseconds);
+
+}
+}
+
+#endif // DATATYPES_H
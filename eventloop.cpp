@@ -0,0 +1,365 @@
+#include "eventloop.h"
+#include "atomic.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <assert.h>
+
+namespace nkdhny {
+namespace db {
+
+AsyncCallback::~AsyncCallback()
+{}
+
+AsyncState::AsyncState(AsyncCallback *_callback):
+    done(false),
+    result(NULL),
+    callback(_callback),
+    references(1)
+{}
+
+AsyncState::~AsyncState()
+{
+    if(result != NULL) {
+        PQclear(result);
+    }
+}
+
+void AsyncState::complete(PGresult *_result)
+{
+    //result could be taken and freed by `Future::get` as soon as the state is done, thus callback goes first
+    if(callback != NULL) {
+        (*callback)(_result);
+    }
+
+    volatile Lock _lock(lock);
+    result = _result;
+    done = true;
+    completed.Broadcast();
+}
+
+void AsyncState::acquire(AsyncState *state)
+{
+    if(state != NULL) {
+        atomicAdd(state->references, 1);
+    }
+}
+
+void AsyncState::release(AsyncState *state)
+{
+    if(state != NULL && atomicAdd(state->references, -1) == 0) {
+        delete state;
+    }
+}
+
+Future::Future():
+    state(NULL)
+{}
+
+Future::Future(AsyncState *_state):
+    state(_state)
+{
+    AsyncState::acquire(state);
+}
+
+Future::Future(const Future &other):
+    state(other.state)
+{
+    AsyncState::acquire(state);
+}
+
+const Future& Future::operator =(const Future &other)
+{
+    AsyncState::acquire(other.state);
+    AsyncState::release(state);
+    state = other.state;
+
+    return *this;
+}
+
+Future::~Future()
+{
+    AsyncState::release(state);
+}
+
+bool Future::ready()
+{
+    assert(state != NULL);
+
+    volatile Lock _lock(state->lock);
+    return state->done;
+}
+
+bool Future::wait(long deadline_ms)
+{
+    assert(state != NULL);
+
+    volatile Lock _lock(state->lock);
+
+    while(!state->done) {
+        if(!state->completed.Wait(state->lock, deadline_ms)) {
+            return state->done;
+        }
+    }
+
+    return true;
+}
+
+Result Future::get()
+{
+    assert(state != NULL);
+
+    PGresult* taken = NULL;
+    {
+        volatile Lock _lock(state->lock);
+
+        while(!state->done) {
+            state->completed.Wait(state->lock);
+        }
+
+        taken = state->result;
+        state->result = NULL;
+    }
+
+    return taken == NULL ? Result() : Result(taken);
+}
+
+EventLoop::EventLoop():
+    epoll(epoll_create1(EPOLL_CLOEXEC)),
+    wakeup(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    running(false),
+    lock(),
+    submitted(),
+    stopping(false),
+    active(),
+    finished()
+{
+    if(epoll < 0 || wakeup < 0) {
+        return;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+
+    running = epoll_ctl(epoll, EPOLL_CTL_ADD, wakeup, &event) == 0 && pthread_create(&thread, NULL, run, this) == 0;
+}
+
+EventLoop::~EventLoop()
+{
+    if(running) {
+        {
+            volatile Lock _lock(lock);
+            stopping = true;
+        }
+
+        wake();
+        pthread_join(thread, NULL);
+    }
+
+    if(wakeup >= 0) {
+        close(wakeup);
+    }
+    if(epoll >= 0) {
+        close(epoll);
+    }
+}
+
+Future EventLoop::watch(PGconn *connection, AsyncCallback *callback)
+{
+    if(!running) {
+        //there is no loop thread, the query is waited for right away
+        AsyncState* state = new AsyncState(callback);
+        Future future(state);
+
+        PQsetnonblocking(connection, 0);
+
+        PGresult* first = NULL;
+        for(PGresult* r = PQgetResult(connection); r != NULL; r = PQgetResult(connection)) {
+            if(first == NULL) {
+                first = r;
+            } else {
+                PQclear(r);
+            }
+        }
+
+        state->complete(first);
+        AsyncState::release(state);
+
+        return future;
+    }
+
+    Operation* op = new Operation();
+    op->connection = connection;
+    op->state = new AsyncState(callback);
+    op->first = NULL;
+    op->writing = false;
+
+    //reference of the loop is the initial one
+    Future future(op->state);
+
+    {
+        volatile Lock _lock(lock);
+        submitted.push_back(op);
+    }
+
+    wake();
+
+    return future;
+}
+
+void EventLoop::wake()
+{
+    uint64_t one = 1;
+
+    //counter of the eventfd which could not be increased (EAGAIN) is far from zero, thus the loop is woken up anyway
+    while(write(wakeup, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+int EventLoop::count()
+{
+    volatile Lock _lock(lock);
+    return submitted.size() + active.size();
+}
+
+void* EventLoop::run(void *arg)
+{
+    EventLoop* loop = reinterpret_cast<EventLoop*>(arg);
+
+    const int capacity = 64;
+    epoll_event events[capacity];
+
+    while(true) {
+        int ready = epoll_wait(loop->epoll, events, capacity, -1);
+        if(ready < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for(int i = 0; i < ready; i++) {
+            Operation* op = reinterpret_cast<Operation*>(events[i].data.ptr);
+
+            if(op == NULL) {
+                uint64_t wakeups;
+                while(read(loop->wakeup, &wakeups, sizeof(wakeups)) > 0) {}
+
+                loop->adopt();
+            } else if(loop->active.count(op) > 0) {
+                loop->process(op);
+            }
+        }
+
+        loop->collect();
+
+        volatile Lock _lock(loop->lock);
+        if(loop->stopping) {
+            break;
+        }
+    }
+
+    //queries in progress are abandoned
+    loop->adopt();
+    while(!loop->active.empty()) {
+        loop->complete(*loop->active.begin());
+    }
+    loop->collect();
+
+    return NULL;
+}
+
+void EventLoop::adopt()
+{
+    std::vector<Operation*> taken;
+    {
+        volatile Lock _lock(lock);
+        taken.swap(submitted);
+    }
+
+    for(size_t i = 0; i < taken.size(); i++) {
+        Operation* op = taken[i];
+
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.ptr = op;
+        op->writing = true;
+
+        {
+            volatile Lock _lock(lock);
+            active.insert(op);
+        }
+
+        if(epoll_ctl(epoll, EPOLL_CTL_ADD, PQsocket(op->connection), &event) != 0) {
+            complete(op);
+            continue;
+        }
+
+        process(op);
+    }
+}
+
+void EventLoop::process(Operation *op)
+{
+    PGconn* c = op->connection;
+
+    int flushed = PQflush(c);
+    if(flushed < 0 || PQconsumeInput(c) != 1) {
+        complete(op);
+        return;
+    }
+
+    while(!PQisBusy(c)) {
+        PGresult* r = PQgetResult(c);
+
+        if(r == NULL) {
+            complete(op);
+            return;
+        }
+
+        //only the first result of the query is kept
+        if(op->first == NULL) {
+            op->first = r;
+        } else {
+            PQclear(r);
+        }
+    }
+
+    bool writing = flushed == 1;
+    if(writing != op->writing) {
+        epoll_event event;
+        event.events = static_cast<uint32_t>(EPOLLIN) | (writing ? static_cast<uint32_t>(EPOLLOUT) : 0);
+        event.data.ptr = op;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, PQsocket(c), &event);
+        op->writing = writing;
+    }
+}
+
+void EventLoop::complete(Operation *op)
+{
+    epoll_ctl(epoll, EPOLL_CTL_DEL, PQsocket(op->connection), NULL);
+    PQsetnonblocking(op->connection, 0);
+
+    {
+        volatile Lock _lock(lock);
+        active.erase(op);
+    }
+
+    op->state->complete(op->first);
+    AsyncState::release(op->state);
+
+    finished.push_back(op);
+}
+
+void EventLoop::collect()
+{
+    for(size_t i = 0; i < finished.size(); i++) {
+        delete finished[i];
+    }
+    finished.clear();
+}
+
+}
+}
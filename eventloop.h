@@ -0,0 +1,127 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <set>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+#include <pthread.h>
+#include "lock.h"
+#include "result.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Action to be called by the event loop thread when an asynchronous query is done
+  * `result` is `NULL` if the connection was broken, it is owned by the `Future` of the query,
+  * the query is reported done (see `Future::ready`) only after the action returns
+  */
+struct AsyncCallback {
+    virtual void operator()(PGresult* result) = 0;
+    virtual ~AsyncCallback();
+};
+
+/** State of an asynchronous query shared by its `Future` handles and the event loop */
+struct AsyncState {
+    Mutex lock;
+    Condition completed;
+    bool done;
+    PGresult* result;
+    AsyncCallback* callback;
+    volatile int references;
+
+    explicit AsyncState(AsyncCallback* _callback);
+    ~AsyncState();
+
+    void complete(PGresult* _result);
+    static void acquire(AsyncState* state);
+    static void release(AsyncState* state);
+};
+
+/** Handle to the result of an asynchronous query (see `Query::sendAsync`)
+  * Handles are copyable and share the state, the result is given to the first caller of `get`
+  */
+class Future
+{
+private:
+    AsyncState* state;
+
+public:
+    Future();
+    explicit Future(AsyncState* _state);
+    Future(const Future& other);
+    const Future& operator =(const Future& other);
+    ~Future();
+
+    /** true if the query is done */
+    bool ready();
+    /** waits until the query is done or until `deadline_ms` (see `gettime_ms`) is reached,
+      * returns false if deadline was reached */
+    bool wait(long deadline_ms);
+    /** waits until the query is done and takes its result, result is not defined
+      * if the connection was broken or the result was taken already */
+    Result get();
+};
+
+/** Thread multiplexing connections with asynchronous queries over epoll
+  * A query is sent by the client thread without waiting (see `Query::sendAsync`), then the connection is
+  * watched by the loop: its socket is flushed when writable and its input consumed when readable,
+  * once libpq is not busy the results are read and the query `Future` is completed.
+  * Connection is in non blocking mode while it is watched and is not to be used by the client until the query is done,
+  * a connection could have only one query in progress
+  *
+  * Destroying the loop completes queries in progress with undefined results
+  */
+class EventLoop
+{
+private:
+    struct Operation {
+        PGconn* connection;
+        AsyncState* state;
+        PGresult* first;
+        bool writing;
+    };
+
+    int epoll;
+    /** wakes the loop up when an operation is submitted or the loop is stopped */
+    int wakeup;
+    pthread_t thread;
+    /** false if the loop thread could not be started, queries are waited for by the caller of `watch` then */
+    bool running;
+
+    Mutex lock;
+    std::vector<Operation*> submitted;
+    bool stopping;
+
+    /** operations watched by the loop, changed by the loop thread only under the lock */
+    std::set<Operation*> active;
+    /** operations completed while the current batch of events is processed, deleted after the batch
+      * as a later event of the batch could still point to them, used by the loop thread only */
+    std::vector<Operation*> finished;
+
+    EventLoop(const EventLoop&);
+    const EventLoop& operator =(const EventLoop&);
+
+    static void* run(void* loop);
+    void adopt();
+    void process(Operation* op);
+    void complete(Operation* op);
+    void collect();
+    /** wakes the loop thread up */
+    void wake();
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    /** watches `connection` with a query already sent until the query is done,
+      * `callback` if given is called by the loop thread then and is to outlive the query */
+    Future watch(PGconn* connection, AsyncCallback* callback = NULL);
+
+    /** count of queries in progress */
+    int count();
+};
+
+}
+}
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,114 @@
+#include "idlestore.h"
+#include "atomic.h"
+#include <sched.h>
+#include <assert.h>
+
+namespace nkdhny {
+namespace db {
+
+IdleConnection::IdleConnection(PGconn *_connection, long _returned, long _expires):
+  connection(_connection),
+  returned(_returned),
+  expires(_expires)
+{}
+
+IdleStore::IdleStore(int _shards, bool _lifo):
+  shards(),
+  lifo(_lifo),
+  size_count(0)
+{
+  assert(_shards > 0);
+
+  for(int i = 0; i < _shards; i++) {
+    shards.push_back(new Shard());
+  }
+}
+
+IdleStore::~IdleStore()
+{
+  for(size_t i = 0; i < shards.size(); i++) {
+    delete shards[i];
+  }
+}
+
+int IdleStore::local()
+{
+  if(shards.size() == 1) {
+    return 0;
+  }
+
+  int cpu = sched_getcpu();
+  if(cpu < 0) {
+    cpu = static_cast<int>(static_cast<unsigned long>(pthread_self()) >> 8);
+  }
+
+  return cpu % shards.size();
+}
+
+void IdleStore::push(const IdleConnection &c)
+{
+  Shard* shard = shards[local()];
+
+  volatile Lock _lock(shard->lock);
+  shard->connections.push_back(c);
+  atomicAdd(size_count, 1);
+}
+
+IdleConnection IdleStore::pop()
+{
+  int first = local();
+
+  for(size_t i = 0; i < shards.size() && atomicGet(size_count) > 0; i++) {
+    Shard* shard = shards[(first + i) % shards.size()];
+
+    volatile Lock _lock(shard->lock);
+    if(shard->connections.empty()) {
+      continue;
+    }
+
+    IdleConnection c;
+    if(lifo) {
+      c = shard->connections.back();
+      shard->connections.pop_back();
+    } else {
+      c = shard->connections.front();
+      shard->connections.pop_front();
+    }
+    atomicAdd(size_count, -1);
+
+    return c;
+  }
+
+  return IdleConnection();
+}
+
+int IdleStore::size()
+{
+  return atomicGet(size_count);
+}
+
+void IdleStore::reap(long now, long idle_timeout, int keep, std::vector<PGconn*>& reaped)
+{
+  for(size_t i = 0; i < shards.size(); i++) {
+    Shard* shard = shards[i];
+
+    volatile Lock _lock(shard->lock);
+
+    std::deque<IdleConnection>::iterator c = shard->connections.begin();
+    while(c != shard->connections.end()) {
+      bool expired = c->expires > 0 && c->expires <= now;
+      bool stale = idle_timeout > 0 && now - c->returned >= idle_timeout && atomicGet(size_count) > keep;
+
+      if(expired || stale) {
+        reaped.push_back(c->connection);
+        c = shard->connections.erase(c);
+        atomicAdd(size_count, -1);
+      } else {
+        ++c;
+      }
+    }
+  }
+}
+
+}
+}
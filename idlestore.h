@@ -0,0 +1,69 @@
+#ifndef IDLESTORE_H
+#define IDLESTORE_H
+
+#include <postgresql/libpq-fe.h>
+#include <vector>
+#include <deque>
+#include "lock.h"
+
+namespace nkdhny {
+namespace db {
+
+/** idle connection together with its bookkeeping */
+struct IdleConnection {
+  PGconn* connection;
+  /** time in ms (see `gettime_ms`) connection was returned to the pool or was created at */
+  long returned;
+  /** time in ms connection is to be destroyed at, 0 if never */
+  long expires;
+
+  explicit IdleConnection(PGconn* _connection = NULL, long _returned = 0, long _expires = 0);
+};
+
+/** Storage for idle connections of a pool
+  * Store is split into `shards`, each guarded by its own mutex. A client works with
+  * the shard of the cpu it is running on and steals connection from other shards
+  * when its own one is empty, so clients running on different cores do not contend for a single lock.
+  * Each shard is a queue (oldest connection is given first) or a stack if `lifo` is set
+  * Store is non copyable
+  */
+class IdleStore
+{
+private:
+  struct Shard {
+    Mutex lock;
+    std::deque<IdleConnection> connections;
+    /** keeps neighbour shards out of each other's cache line */
+    char padding[64];
+  };
+
+  std::vector<Shard*> shards;
+  bool lifo;
+  volatile int size_count;
+
+  IdleStore(const IdleStore&);
+  const IdleStore& operator=(const IdleStore&);
+
+  /** shard of the calling thread */
+  int local();
+
+public:
+  IdleStore(int _shards, bool _lifo);
+  ~IdleStore();
+
+  /** puts connection to the local shard */
+  void push(const IdleConnection& c);
+  /** takes connection from the local shard or steals one from the others,
+    * returned `connection` is `NULL` if the store is empty */
+  IdleConnection pop();
+  /** count of connections in store */
+  int size();
+  /** takes out connections expired at `now` and connections idle for `idle_timeout` ms or longer
+    * (if `idle_timeout` is not 0), unless store has no more than `keep` connections */
+  void reap(long now, long idle_timeout, int keep, std::vector<PGconn*>& reaped);
+};
+
+}
+}
+
+#endif // IDLESTORE_H
@@ -1,4 +1,5 @@
 #include "lock.h"
+#include <errno.h>
 
 namespace nkdhny{
 
@@ -33,5 +34,38 @@ Lock::~Lock()
   _ref->Unlock();
 }
 
+Condition::Condition()
+{
+  pthread_cond_init(&this->m_cond, NULL);
+}
+
+Condition::~Condition()
+{
+  pthread_cond_destroy(&this->m_cond);
+}
+
+void Condition::Wait(Mutex& mutex)
+{
+  pthread_cond_wait(&this->m_cond, &mutex.m_mutex);
+}
+
+bool Condition::Wait(Mutex& mutex, long deadline_ms)
+{
+  struct timespec deadline;
+  deadline.tv_sec = deadline_ms / 1000;
+  deadline.tv_nsec = (deadline_ms % 1000) * 1000000;
+
+  return pthread_cond_timedwait(&this->m_cond, &mutex.m_mutex, &deadline) != ETIMEDOUT;
+}
+
+void Condition::Signal()
+{
+  pthread_cond_signal(&this->m_cond);
+}
+
+void Condition::Broadcast()
+{
+  pthread_cond_broadcast(&this->m_cond);
+}
 
 }
@@ -5,6 +5,8 @@
 
 namespace nkdhny{
 
+class Condition;
+
 class Mutex
 {
 public:
@@ -16,6 +18,8 @@ public:
 
 private:
   pthread_mutex_t m_mutex;
+
+  friend class Condition;
 };
 
 class Lock
@@ -29,7 +33,27 @@ private:
   Mutex * _ref;
 };
 
+/** Condition variable to be used together with a locked `Mutex`
+  * `Wait` releases the mutex while sleeping and reacquires it before return
+  */
+class Condition
+{
+public:
+  Condition();
+  ~Condition();
+
+  void Wait(Mutex& mutex);
+  /** waits until signaled or until `deadline_ms` (see `gettime_ms`) is reached
+    * returns false if deadline was reached */
+  bool Wait(Mutex& mutex, long deadline_ms);
+  void Signal();
+  void Broadcast();
+
+private:
+  Condition(const Condition&);
+  pthread_cond_t m_cond;
+};
+
 }
 
 #endif //LOCK_H
-
@@ -1,141 +1,272 @@
 #include "parambuilder.h"
+#include <endian.h>
 
 namespace nkdhny {
 namespace db {
 
-
-static void deleteParameter(Parameter* p) {
-    delete p;
+ParamBuilder::ParamBuilder():
+    value_list(),
+    size_list(),
+    format_list(),
+    type_list(),
+    arena(inline_arena),
+    arena_size(0),
+    arena_capacity(INLINE_ARENA_SIZE)
+{
 }
 
-struct FormatBuilder {
-    int operator ()(Parameter* p) {
-        return p->format;
+ParamBuilder::~ParamBuilder()
+{
+    if(arena != inline_arena) {
+        delete[] arena;
     }
-};
+}
 
-struct SizeBuilder {
-    int operator ()(Parameter* p) {
-        return p->size;
-    }
-};
+size_t ParamBuilder::reserve(size_t size)
+{
+    if(arena_size + size > arena_capacity) {
+        size_t capacity = std::max(2*arena_capacity, arena_size + size);
+        char* grown = new char[capacity];
+        memcpy(grown, arena, arena_size);
 
-struct ValueBuilder {
-    char* operator()(Parameter* p) {
-        return p->value;
-    }
-};
+        for(size_t i = 0; i < value_list.size(); i++) {
+            value_list[i] = grown + (value_list[i] - arena);
+        }
 
-ParamBuilder::ParamBuilder():
-    params()
-{
-}
+        if(arena != inline_arena) {
+            delete[] arena;
+        }
 
-ParamBuilder::~ParamBuilder()
-{
-    clear();
+        arena = grown;
+        arena_capacity = capacity;
+    }
+
+    size_t offset = arena_size;
+    arena_size += size;
+    return offset;
 }
 
-std::vector<ParamBuilder::Values> ParamBuilder::values()
+char* ParamBuilder::allocate(int _size, int _format, Oid _type)
 {
-    std::vector<ParamBuilder::Values> v(params.size());
+    size_t offset = reserve(_size);
 
-    ValueBuilder builder;
-    std::transform(params.begin(), params.end(), v.begin(), builder);
+    value_list.push_back(arena + offset);
+    size_list.push_back(_size);
+    format_list.push_back(_format);
+    type_list.push_back(_type);
 
-    return v;
+    return arena + offset;
 }
 
-std::vector<ParamBuilder::Formats> ParamBuilder::formats()
+ParamBuilder& ParamBuilder::append(const char *_value, int _size, int _format, Oid _type)
 {
-    std::vector<ParamBuilder::Formats> f(params.size());
+    memcpy(allocate(_size, _format, _type), _value, _size);
+    return *this;
+}
 
-    FormatBuilder builder;
-    std::transform(params.begin(), params.end(), f.begin(), builder);
+ParamBuilder& ParamBuilder::append(const Parameter &parameter)
+{
+    return append(parameter.value, parameter.size, parameter.format);
+}
 
-    return f;
+const ParamBuilder::Values* ParamBuilder::values()
+{
+    return value_list.empty() ? NULL : &value_list[0];
 }
 
-std::vector<ParamBuilder::Sizes> ParamBuilder::sizes()
+const ParamBuilder::Formats* ParamBuilder::formats()
 {
-    std::vector<ParamBuilder::Sizes> s(params.size());
+    return format_list.empty() ? NULL : &format_list[0];
+}
 
-    SizeBuilder builder;
-    std::transform(params.begin(), params.end(), s.begin(), builder);
+const ParamBuilder::Sizes* ParamBuilder::sizes()
+{
+    return size_list.empty() ? NULL : &size_list[0];
+}
 
-    return s;
+const Oid* ParamBuilder::types()
+{
+    return type_list.empty() ? NULL : &type_list[0];
 }
 
 ParamBuilder &ParamBuilder::clear()
 {
-    std::for_each(params.begin(), params.end(), deleteParameter);
-    params.clear();
+    value_list.clear();
+    size_list.clear();
+    format_list.clear();
+    type_list.clear();
+    arena_size = 0;
+
+    return *this;
 }
 
 int ParamBuilder::count()
 {
-    return params.size();
+    return value_list.size();
+}
+
+/** size of the header of a one dimensional array in binary format:
+  * count of dimensions, flags, element type, size and lower bound of the dimension,
+  * empty array has no dimensions */
+static int arrayHeaderSize(size_t count) {
+    return (count == 0 ? 3 : 5)*sizeof(uint32_t);
+}
+
+static char* writeUint32(char* room, uint32_t value) {
+    value = htobe32(value);
+    memcpy(room, &value, sizeof(value));
+    return room + sizeof(value);
+}
+
+static char* writeArrayHeader(char* room, Oid element, size_t count) {
+    room = writeUint32(room, count == 0 ? 0 : 1);
+    room = writeUint32(room, 0);
+    room = writeUint32(room, element);
+
+    if(count > 0) {
+        room = writeUint32(room, count);
+        room = writeUint32(room, 1);
+    }
+
+    return room;
 }
 
 template <>
-ParamBuilder& ParamBuilder::push<std::string>(std::string _value) {
-    TextParameter *parameter = new TextParameter(_value);
-    params.push_back(parameter);
+ParamBuilder& ParamBuilder::push< std::vector<int> >(std::vector<int> _value) {
+    int size = arrayHeaderSize(_value.size()) + _value.size()*2*sizeof(uint32_t);
+    char* room = writeArrayHeader(allocate(size, Parameter::BINARY_FORMAT, pgtype::INT4ARRAY), pgtype::INT4, _value.size());
+
+    for(size_t i = 0; i < _value.size(); i++) {
+        room = writeUint32(room, sizeof(uint32_t));
+        room = writeUint32(room, static_cast<uint32_t>(_value[i]));
+    }
 
     return *this;
 }
+
 template <>
-ParamBuilder& ParamBuilder::push<char*>(char* _value) {
-    TextParameter *parameter = new TextParameter(std::string(_value));
-    params.push_back(parameter);
+ParamBuilder& ParamBuilder::push< std::vector<long> >(std::vector<long> _value) {
+    int size = arrayHeaderSize(_value.size()) + _value.size()*(sizeof(uint32_t) + sizeof(uint64_t));
+    char* room = writeArrayHeader(allocate(size, Parameter::BINARY_FORMAT, pgtype::INT8ARRAY), pgtype::INT8, _value.size());
+
+    for(size_t i = 0; i < _value.size(); i++) {
+        room = writeUint32(room, sizeof(uint64_t));
+
+        uint64_t binary = htobe64(static_cast<uint64_t>(_value[i]));
+        memcpy(room, &binary, sizeof(binary));
+        room += sizeof(binary);
+    }
 
     return *this;
 }
+
 template <>
-ParamBuilder& ParamBuilder::push<int>(int _value) {
-    IntegerParameter *parameter = new IntegerParameter(_value);
-    params.push_back(parameter);
+ParamBuilder& ParamBuilder::push< std::vector<std::string> >(std::vector<std::string> _value) {
+    int size = arrayHeaderSize(_value.size());
+    for(size_t i = 0; i < _value.size(); i++) {
+        size += sizeof(uint32_t) + _value[i].size();
+    }
+
+    char* room = writeArrayHeader(allocate(size, Parameter::BINARY_FORMAT, pgtype::TEXTARRAY), pgtype::TEXT, _value.size());
+
+    //elements of text array have no terminating zero
+    for(size_t i = 0; i < _value.size(); i++) {
+        room = writeUint32(room, _value[i].size());
+        memcpy(room, _value[i].data(), _value[i].size());
+        room += _value[i].size();
+    }
 
     return *this;
 }
+
+template <>
+ParamBuilder& ParamBuilder::push<std::string>(std::string _value) {
+    return append(_value.c_str(), _value.size()+1, Parameter::TEXT_FORMAT);
+}
+template <>
+ParamBuilder& ParamBuilder::push<char*>(char* _value) {
+    return append(_value, strlen(_value)+1, Parameter::TEXT_FORMAT);
+}
+template <>
+ParamBuilder& ParamBuilder::push<int>(int _value) {
+    uint32_t binary = htonl(static_cast<uint32_t>(_value));
+    return append(reinterpret_cast<const char*>(&binary), sizeof(uint32_t), Parameter::BINARY_FORMAT, pgtype::INT4);
+}
 template <>
 ParamBuilder& ParamBuilder::push<unsigned>(unsigned _value) {
-    IntegerParameter *parameter = new IntegerParameter(static_cast<int>(_value));
-    params.push_back(parameter);
-
-    return *this;
+    return push<int>(static_cast<int>(_value));
 }
 
 template <>
 ParamBuilder& ParamBuilder::push<long>(long _value) {
-    LongParameter *parameter = new LongParameter(_value);
-    params.push_back(parameter);
-
-    return *this;
+#ifdef DEBUG
+    assert(sizeof(uint64_t) == sizeof(long));
+#endif
+    uint64_t binary = htobe64(static_cast<uint64_t>(_value));
+    return append(reinterpret_cast<const char*>(&binary), sizeof(uint64_t), Parameter::BINARY_FORMAT, pgtype::INT8);
 }
 template <>
 ParamBuilder& ParamBuilder::push<unsigned long>(unsigned long _value) {
-    LongParameter *parameter = new LongParameter(static_cast<long>(_value));
-    params.push_back(parameter);
+    return push<long>(static_cast<long>(_value));
+}
 
-    return *this;
+template <>
+ParamBuilder& ParamBuilder::push<float>(float _value) {
+    uint32_t binary;
+    memcpy(&binary, &_value, sizeof(binary));
+    binary = htobe32(binary);
+    return append(reinterpret_cast<const char*>(&binary), sizeof(binary), Parameter::BINARY_FORMAT, pgtype::FLOAT4);
 }
 
 template <>
-ParamBuilder& ParamBuilder::push<long long>(long long _value) {
-    LongLongParameter *parameter = new LongLongParameter(_value);
-    params.push_back(parameter);
+ParamBuilder& ParamBuilder::push<double>(double _value) {
+    uint64_t binary;
+    memcpy(&binary, &_value, sizeof(binary));
+    binary = htobe64(binary);
+    return append(reinterpret_cast<const char*>(&binary), sizeof(binary), Parameter::BINARY_FORMAT, pgtype::FLOAT8);
+}
 
-    return *this;
+template <>
+ParamBuilder& ParamBuilder::push<bool>(bool _value) {
+    char binary = _value ? 1 : 0;
+    return append(&binary, sizeof(binary), Parameter::BINARY_FORMAT, pgtype::BOOL);
 }
+
 template <>
-ParamBuilder& ParamBuilder::push<unsigned long long>(unsigned long long _value) {
-    LongLongParameter *parameter = new LongLongParameter(static_cast<long long>(_value));
-    params.push_back(parameter);
+ParamBuilder& ParamBuilder::push<Timestamp>(Timestamp _value) {
+    uint64_t binary = htobe64(static_cast<uint64_t>(toServerEpoch(_value)));
+    //the same representation for timestamp and timestamptz, the type is inferred by the server
+    return append(reinterpret_cast<const char*>(&binary), sizeof(binary), Parameter::BINARY_FORMAT, pgtype::UNSPECIFIED);
+}
 
-    return *this;
+template <>
+ParamBuilder& ParamBuilder::push<Numeric>(Numeric _value) {
+    std::string binary;
+    if(!encodeNumeric(_value.value, binary)) {
+        //value not encoded on the client, e.g. "1e5", is parsed by the server, which rejects it unless it is a number
+        return append(_value.value.c_str(), _value.value.size()+1, Parameter::TEXT_FORMAT, pgtype::NUMERIC);
+    }
+    return append(binary.data(), binary.size(), Parameter::BINARY_FORMAT, pgtype::NUMERIC);
+}
+
+template <>
+ParamBuilder& ParamBuilder::push<Uuid>(Uuid _value) {
+    return append(reinterpret_cast<const char*>(_value.bytes), sizeof(_value.bytes), Parameter::BINARY_FORMAT, pgtype::UUID);
 }
 
+template <>
+ParamBuilder& ParamBuilder::push<Bytea>(Bytea _value) {
+    return append(_value.bytes.data(), _value.bytes.size(), Parameter::BINARY_FORMAT, pgtype::BYTEA);
 }
+
+template <>
+ParamBuilder& ParamBuilder::push<long long>(long long _value) {
+    return push<long>(static_cast<long>(_value));
+}
+template <>
+ParamBuilder& ParamBuilder::push<unsigned long long>(unsigned long long _value) {
+    return push<long>(static_cast<long>(_value));
 }
 
+}
+}
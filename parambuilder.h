@@ -6,6 +6,8 @@
 #include <algorithm>
 
 #include "parameter.h"
+#include "pgtypes.h"
+#include "datatypes.h"
 
 namespace nkdhny{
 namespace db{
@@ -16,12 +18,15 @@ namespace db{
   * Thus one should explicitly specify template method
   * `push` (see bellow) with ones own type.
   * Builder is non copyable
+  * Binary representations of all parameters are kept one after another in a single byte arena,
+  * which is inline for a few small parameters and grows on the heap otherwise. Clearing the builder
+  * keeps the arena, thus builder reused for the same parameters does not allocate
   * Builder could be used separate from template class, like this
   * @verbatim
   *     int foo_id = 1;
   *     ParamBuilder b;
   *     b.push(f);
-  *     PGresult* result = PQexecParams(connection, "select * from foo where id = $1", b.count(), NULL, b.values().get(), b.sizes().get(), b.formats().get(), Parameter::BINARY_FORMAT);
+  *     PGresult* result = PQexecParams(connection, "select * from foo where id = $1", b.count(), b.types(), b.values(), b.sizes(), b.formats(), Parameter::BINARY_FORMAT);
   */
 class ParamBuilder
 {
@@ -30,7 +35,26 @@ private:
     ParamBuilder(const ParamBuilder&);
     ParamBuilder& operator=(const ParamBuilder&);
 
-    std::vector<Parameter*> params;
+    static const size_t INLINE_ARENA_SIZE = 128;
+
+    /** arrays to be given to libpq as is, appended by each push,
+      * `value_list` points into the arena and is moved with it when it grows */
+    std::vector<char*> value_list;
+    std::vector<int> size_list;
+    std::vector<int> format_list;
+    std::vector<Oid> type_list;
+
+    char inline_arena[INLINE_ARENA_SIZE];
+    /** either `inline_arena` or a heap block */
+    char* arena;
+    size_t arena_size;
+    size_t arena_capacity;
+
+    /** makes room for `size` more bytes at the end of the arena, returns offset of the room */
+    size_t reserve(size_t size);
+    /** adds a parameter of `_size` bytes to my parameter list, returns its room in the arena to be filled,
+      * the room is valid until next push */
+    char* allocate(int _size, int _format, Oid _type);
 
 
 public:
@@ -46,8 +70,7 @@ public:
     ParamBuilder();
     ~ParamBuilder();
 
-    /** Add copy of `_value` to my parameter list. Parameters are represented as a
-      * pointers to a derivatives of a `Parameter` class
+    /** Add binary representation of `_value` to my parameter list.
       * The template method is stub in sence that it has only specializations for common and domain types.
       * No generic method is defined.
       * When one wants to push some type `Foo` to a query one has several options:
@@ -60,35 +83,48 @@ public:
       * namespace db{
       * template <>
       * ParamBuilder& ParamBuilder::push<Foo>(Foo _value) {
-      *     IntegerParameter *parameter = new IntegerParameter(_value.id);
-      *     params.push_back(parameter);
-      *     return *this;
+      *     return push<int>(_value.id);
       * }
       *
-      * (ii) define ones own `Parameter` subclass representing `Foo` in the DB
-      * see e.g. `nkdhny::db::Position3DParameter` and specialization
-      * `push<Position3D>`
+      * (ii) append ones own binary representation of `Foo` (see `append`) or
+      * define ones own `Parameter` subclass representing `Foo` in the DB and append it
       * @endverbatim
       *
+      * Besides integers and text, `float`, `double`, `bool`, `Timestamp`, `Numeric`, `Uuid` and `Bytea`
+      * are pushed in binary representation of the corresponding server type (see `datatypes.h`),
+      * `Numeric` which could not be encoded on the client is pushed as text to be parsed by the server.
+      * `std::vector` of `int`, `long` or `std::string` is pushed as a one dimensional array
+      * (`int4[]`, `int8[]` or `text[]`), thus a set of values could be given as a single parameter,
+      * like `select * from foo where id = ANY($1)`
       */
     template <typename _T>
     ParamBuilder& push(_T _value);
 
-    /** @brief prepare `const char * const *paramValues`
-      * for `PQexecParams` based on my params */
-    std::vector<Values>   values();
+    /** Add copy of `_size` bytes of `_value` to my parameter list as a parameter of `_format`,
+      * `_type` is the OID of the server type the binary representation is of, if known */
+    ParamBuilder& append(const char* _value, int _size, int _format, Oid _type = pgtype::UNSPECIFIED);
+    /** Add copy of the `parameter` representation to my parameter list */
+    ParamBuilder& append(const Parameter& parameter);
+
+    /** @brief `const char * const *paramValues`
+      * for `PQexecParams` based on my params, valid until next push or clear,
+      * `NULL` if there are no params */
+    const Values*   values();
 
-    /** @brief prepare `const int * paramLengths`
+    /** @brief `const int * paramLengths`
       * for `PQexecParams` based on my params */
-    std::vector<Sizes>    sizes();
+    const Sizes*    sizes();
 
-    /** @brief prepare `const int * paramFormats`
+    /** @brief `const int * paramFormats`
       * for `PQexecParams` based on my params */
-    std::vector<Formats>  formats();
+    const Formats*  formats();
+
+    /** @brief OIDs of types of my params, `pgtype::UNSPECIFIED` for params
+      * which type is inferred by the server */
+    const Oid*      types();
 
-    /** @brief clears the parameter list by calling destructors
-      * of all cotaining parameters and clearing
-      * the containr holding its pointers */
+    /** @brief clears the parameter list, memory taken by parameters
+      * is kept to be reused by subsequent ones */
     ParamBuilder& clear();
     /** @brief count of the parameter currently pushed in */
     int count();
@@ -0,0 +1,193 @@
+#include "parambuilder.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+TEST(ParamBuilderTest, shouldEncodeIntegersInNetworkOrder) {
+  nkdhny::db::ParamBuilder b;
+  b.push<int>(0x01020304);
+  b.push<long>(0x0102030405060708L);
+
+  ASSERT_EQ(2, b.count());
+
+  const nkdhny::db::ParamBuilder::Values* values = b.values();
+  const nkdhny::db::ParamBuilder::Sizes* sizes = b.sizes();
+  const nkdhny::db::ParamBuilder::Formats* formats = b.formats();
+
+  EXPECT_EQ(4, sizes[0]);
+  EXPECT_EQ(8, sizes[1]);
+  EXPECT_EQ(nkdhny::db::Parameter::BINARY_FORMAT, formats[0]);
+  EXPECT_EQ(nkdhny::db::Parameter::BINARY_FORMAT, formats[1]);
+  EXPECT_EQ(nkdhny::db::pgtype::INT4, b.types()[0]);
+  EXPECT_EQ(nkdhny::db::pgtype::INT8, b.types()[1]);
+
+  for(int i = 0; i < 4; i++) {
+    EXPECT_EQ(i+1, values[0][i]);
+  }
+  for(int i = 0; i < 8; i++) {
+    EXPECT_EQ(i+1, values[1][i]);
+  }
+}
+
+TEST(ParamBuilderTest, shouldKeepParametersWhenArenaGrows) {
+  nkdhny::db::ParamBuilder b;
+
+  std::string small("foo");
+  std::string large(1000, 'x');
+
+  b.push(small);
+  b.push<int>(42);
+  b.push(large);
+
+  const nkdhny::db::ParamBuilder::Values* values = b.values();
+  const nkdhny::db::ParamBuilder::Sizes* sizes = b.sizes();
+
+  EXPECT_EQ(small, std::string(values[0]));
+  EXPECT_EQ(static_cast<int>(small.size()+1), sizes[0]);
+  EXPECT_EQ(42, values[1][3]);
+  EXPECT_EQ(large, std::string(values[2]));
+  EXPECT_EQ(nkdhny::db::Parameter::TEXT_FORMAT, b.formats()[2]);
+}
+
+TEST(ParamBuilderTest, shouldGiveNoArraysWithoutParameters) {
+  nkdhny::db::ParamBuilder b;
+
+  EXPECT_TRUE(b.values() == NULL);
+  EXPECT_TRUE(b.sizes() == NULL);
+  EXPECT_TRUE(b.formats() == NULL);
+}
+
+TEST(ParamBuilderTest, shouldReuseArenaAfterClear) {
+  nkdhny::db::ParamBuilder b;
+  std::string large(1000, 'x');
+
+  b.push(large);
+  char* first = b.values()[0];
+
+  b.clear();
+  EXPECT_EQ(0, b.count());
+
+  b.push(large);
+  EXPECT_EQ(first, b.values()[0]);
+}
+
+TEST(ParamBuilderTest, shouldAppendParameterRepresentation) {
+  nkdhny::db::ParamBuilder b;
+  nkdhny::db::IntegerParameter p(7);
+
+  b.append(p);
+
+  EXPECT_EQ(1, b.count());
+  EXPECT_EQ(4, b.sizes()[0]);
+  EXPECT_EQ(7, b.values()[0][3]);
+}
+
+TEST(ParamBuilderTest, shouldEncodeVectorAsOneDimensionalArray) {
+  nkdhny::db::ParamBuilder b;
+  std::vector<int> ids;
+  ids.push_back(1);
+  ids.push_back(2);
+
+  b.push(ids);
+  b.push(std::vector<std::string>(1, "ab"));
+  b.push(std::vector<long>());
+
+  ASSERT_EQ(3, b.count());
+  EXPECT_EQ(nkdhny::db::pgtype::INT4ARRAY, b.types()[0]);
+  EXPECT_EQ(nkdhny::db::pgtype::TEXTARRAY, b.types()[1]);
+  EXPECT_EQ(nkdhny::db::pgtype::INT8ARRAY, b.types()[2]);
+  EXPECT_EQ(nkdhny::db::Parameter::BINARY_FORMAT, b.formats()[0]);
+
+  //header of five words then length and value of each element
+  const unsigned char ints[] = {0,0,0,1, 0,0,0,0, 0,0,0,23, 0,0,0,2, 0,0,0,1,
+                                0,0,0,4, 0,0,0,1, 0,0,0,4, 0,0,0,2};
+  ASSERT_EQ(static_cast<int>(sizeof(ints)), b.sizes()[0]);
+  EXPECT_EQ(0, memcmp(ints, b.values()[0], sizeof(ints)));
+
+  const unsigned char texts[] = {0,0,0,1, 0,0,0,0, 0,0,0,25, 0,0,0,1, 0,0,0,1,
+                                 0,0,0,2, 'a','b'};
+  ASSERT_EQ(static_cast<int>(sizeof(texts)), b.sizes()[1]);
+  EXPECT_EQ(0, memcmp(texts, b.values()[1], sizeof(texts)));
+
+  //empty array has no dimensions
+  const unsigned char empty[] = {0,0,0,0, 0,0,0,0, 0,0,0,20};
+  ASSERT_EQ(static_cast<int>(sizeof(empty)), b.sizes()[2]);
+  EXPECT_EQ(0, memcmp(empty, b.values()[2], sizeof(empty)));
+}
+
+TEST(ParamBuilderTest, shouldEncodeNumericInBase10000Digits) {
+  nkdhny::db::ParamBuilder b;
+  b.push(nkdhny::db::Numeric("-12.3400"));
+
+  //count of digits, weight, sign, display scale, digits
+  const unsigned char binary[] = {0,2, 0,0, 0x40,0, 0,4, 0,12, 0x0d,0x48};
+  ASSERT_EQ(static_cast<int>(sizeof(binary)), b.sizes()[0]);
+  EXPECT_EQ(0, memcmp(binary, b.values()[0], sizeof(binary)));
+  EXPECT_EQ(nkdhny::db::pgtype::NUMERIC, b.types()[0]);
+}
+
+TEST(ParamBuilderTest, shouldPushNotEncodedNumericAsText) {
+  nkdhny::db::ParamBuilder b;
+  b.push(nkdhny::db::Numeric("1e5"));
+  b.push(nkdhny::db::Numeric("abc"));
+
+  ASSERT_EQ(2, b.count());
+  EXPECT_EQ(nkdhny::db::Parameter::TEXT_FORMAT, b.formats()[0]);
+  EXPECT_STREQ("1e5", b.values()[0]);
+  EXPECT_EQ(nkdhny::db::Parameter::TEXT_FORMAT, b.formats()[1]);
+  EXPECT_STREQ("abc", b.values()[1]);
+  EXPECT_EQ(nkdhny::db::pgtype::NUMERIC, b.types()[1]);
+}
+
+TEST(ParamBuilderTest, shouldDecodeNumericAsEncoded) {
+  const char* values[] = {"0", "1", "-1", "10000", "123456789.000000001", "0.0001", "-0.00012300",
+                          "99990000", "3.14", "NaN", "Infinity", "-Infinity"};
+
+  for(size_t i = 0; i < sizeof(values)/sizeof(values[0]); i++) {
+    std::string binary;
+    ASSERT_TRUE(nkdhny::db::encodeNumeric(values[i], binary)) << values[i];
+    EXPECT_EQ(values[i], nkdhny::db::decodeNumeric(binary.data(), binary.size()));
+  }
+
+  std::string binary;
+  EXPECT_FALSE(nkdhny::db::encodeNumeric("1e5", binary));
+  EXPECT_FALSE(nkdhny::db::encodeNumeric("", binary));
+}
+
+TEST(ParamBuilderTest, shouldParseAndPrintUuid) {
+  nkdhny::db::Uuid uuid;
+  ASSERT_TRUE(nkdhny::db::Uuid::parse("A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11", uuid));
+  EXPECT_EQ(0xa0, uuid.bytes[0]);
+  EXPECT_EQ(0x11, uuid.bytes[15]);
+  EXPECT_EQ("a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11", uuid.str());
+
+  EXPECT_FALSE(nkdhny::db::Uuid::parse("a0eebc99", uuid));
+  EXPECT_FALSE(nkdhny::db::Uuid::parse("x0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11", uuid));
+}
+
+TEST(ParamBuilderTest, shouldEncodeFloatsBoolAndTimestamp) {
+  nkdhny::db::ParamBuilder b;
+  b.push(1.0f);
+  b.push(-2.0);
+  b.push(true);
+  b.push(nkdhny::db::Timestamp(nkdhny::db::POSTGRES_EPOCH_MICROSECONDS + 1));
+
+  const unsigned char one[] = {0x3f, 0x80, 0, 0};
+  const unsigned char minus_two[] = {0xc0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned char after_epoch[] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+  EXPECT_EQ(0, memcmp(one, b.values()[0], sizeof(one)));
+  EXPECT_EQ(0, memcmp(minus_two, b.values()[1], sizeof(minus_two)));
+  EXPECT_EQ(1, b.values()[2][0]);
+  EXPECT_EQ(0, memcmp(after_epoch, b.values()[3], sizeof(after_epoch)));
+
+  EXPECT_EQ(nkdhny::db::pgtype::FLOAT4, b.types()[0]);
+  EXPECT_EQ(nkdhny::db::pgtype::FLOAT8, b.types()[1]);
+  EXPECT_EQ(nkdhny::db::pgtype::BOOL, b.types()[2]);
+  EXPECT_EQ(nkdhny::db::pgtype::UNSPECIFIED, b.types()[3]);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
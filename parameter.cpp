@@ -26,7 +26,7 @@ Parameter::Parameter(int _format):
 Parameter::~Parameter()
 {
     if(value){
-        delete value;
+        delete[] value;
     }
 }
 
@@ -0,0 +1,38 @@
+#ifndef PGTYPES_H
+#define PGTYPES_H
+
+#include <postgresql/postgres_ext.h>
+
+namespace nkdhny {
+namespace db {
+
+/** OIDs of built-in server types (see `pg_type` catalog), server headers are not required to be installed */
+namespace pgtype {
+
+/** type of a parameter is to be inferred by the server */
+const Oid UNSPECIFIED = 0;
+
+const Oid BOOL = 16;
+const Oid BYTEA = 17;
+const Oid INT8 = 20;
+const Oid INT4 = 23;
+const Oid TEXT = 25;
+const Oid FLOAT4 = 700;
+const Oid FLOAT8 = 701;
+const Oid BPCHAR = 1042;
+const Oid VARCHAR = 1043;
+const Oid TIMESTAMP = 1114;
+const Oid TIMESTAMPTZ = 1184;
+const Oid NUMERIC = 1700;
+const Oid UUID = 2950;
+
+const Oid INT4ARRAY = 1007;
+const Oid TEXTARRAY = 1009;
+const Oid INT8ARRAY = 1016;
+
+}
+
+}
+}
+
+#endif // PGTYPES_H
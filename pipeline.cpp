@@ -0,0 +1,256 @@
+#include "pipeline.h"
+#include <poll.h>
+#include <errno.h>
+
+namespace nkdhny {
+namespace db {
+
+Pipeline::Pipeline(PGconn *_connection):
+    connection(_connection),
+    parameters(),
+    started(false),
+    broken(false),
+    sent(),
+    received(0),
+    current(NULL),
+    results()
+{}
+
+Pipeline::~Pipeline()
+{
+    if(started) {
+        finish();
+    }
+    release();
+}
+
+Pipeline& Pipeline::prepare(const std::string &sql)
+{
+    assert(!started);
+
+    //statement which could not be prepared is not found when the query is queued, thus the query is sent as is
+    StatementCache::prepare(connection, sql);
+
+    return *this;
+}
+
+void Pipeline::start()
+{
+    release();
+
+    sent.clear();
+    received = 0;
+    broken = false;
+
+    bool entered = PQenterPipelineMode(connection) == 1 && PQsetnonblocking(connection, 1) == 0;
+    assert(entered);
+    broken = !entered;
+
+    started = true;
+}
+
+Pipeline& Pipeline::queue(const std::string &sql)
+{
+    if(!started) {
+        start();
+    }
+
+    const PreparedStatement* statement = StatementCache::find(connection, sql, parameters);
+
+    int queued = statement == NULL ?
+        PQsendQueryParams(connection, sql.c_str(), parameters.count(), parameters.types(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1) :
+        PQsendQueryPrepared(connection, statement->name.c_str(), parameters.count(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
+    parameters.clear();
+
+    if(queued != 1) {
+        //query keeps its place thus indices of results of the following queries are not shifted
+        sent.push_back(FAILED);
+        broken = broken || PQstatus(connection) == CONNECTION_BAD;
+        return *this;
+    }
+
+    sent.push_back(QUERY);
+    pump(false);
+
+    return *this;
+}
+
+Pipeline& Pipeline::sync()
+{
+    if(!started) {
+        start();
+    }
+
+    if(PQpipelineSync(connection) != 1) {
+        broken = true;
+        return *this;
+    }
+
+    sent.push_back(SYNC);
+    pump(false);
+
+    return *this;
+}
+
+int Pipeline::operator ()()
+{
+    if(!started) {
+        return 0;
+    }
+
+    finish();
+
+    return results.size();
+}
+
+void Pipeline::finish()
+{
+    //server sends nothing for queries after the last sync point, waiting for their results would never end
+    if(sent.empty() || sent.back() != SYNC) {
+        sync();
+    }
+
+    while(!broken && received < sent.size()) {
+        pump(true);
+    }
+
+    //results of queries that were not read are not defined
+    for(size_t i = received; i < sent.size(); i++) {
+        if(sent[i] != SYNC) {
+            results.push_back(current);
+            current = NULL;
+        }
+    }
+
+    if(broken) {
+        //results still buffered are discarded, connection is not to be left in pipeline mode
+        //each query ends with NULL, two NULLs in a row mean nothing is left
+        bool ended = false;
+        while(!PQisBusy(connection)) {
+            PGresult* r = PQgetResult(connection);
+            if(r == NULL) {
+                if(ended) {
+                    break;
+                }
+                ended = true;
+                continue;
+            }
+            ended = false;
+            PQclear(r);
+        }
+    }
+
+    if(PQexitPipelineMode(connection) != 1) {
+        PQreset(connection);
+    }
+    PQsetnonblocking(connection, 0);
+
+    started = false;
+}
+
+void Pipeline::pump(bool wait)
+{
+    if(broken) {
+        return;
+    }
+
+    int flushed = PQflush(connection);
+    if(flushed < 0) {
+        broken = true;
+        return;
+    }
+
+    if(wait || flushed == 1) {
+        pollfd descriptor;
+        descriptor.fd = PQsocket(connection);
+        descriptor.events = POLLIN | (flushed == 1 ? POLLOUT : 0);
+        descriptor.revents = 0;
+
+        if(poll(&descriptor, 1, -1) < 0 && errno != EINTR) {
+            broken = true;
+            return;
+        }
+    }
+
+    if(PQconsumeInput(connection) != 1) {
+        broken = true;
+        return;
+    }
+
+    collect();
+}
+
+void Pipeline::collect()
+{
+    while(received < sent.size()) {
+        if(sent[received] == FAILED) {
+            results.push_back(NULL);
+            ++received;
+            continue;
+        }
+
+        if(PQisBusy(connection)) {
+            break;
+        }
+
+        PGresult* r = PQgetResult(connection);
+
+        if(sent[received] == SYNC) {
+            //sync point gives a single result without NULL after it
+            if(r == NULL) {
+                break;
+            }
+            PQclear(r);
+            ++received;
+            continue;
+        }
+
+        if(r == NULL) {
+            //all results of the query are read, only the first one is kept
+            results.push_back(current);
+            current = NULL;
+            ++received;
+        } else if(current == NULL) {
+            current = r;
+        } else {
+            PQclear(r);
+        }
+    }
+}
+
+void Pipeline::release()
+{
+    for(size_t i = 0; i < results.size(); i++) {
+        if(results[i] != NULL) {
+            PQclear(results[i]);
+        }
+    }
+    results.clear();
+
+    if(current != NULL) {
+        PQclear(current);
+        current = NULL;
+    }
+}
+
+int Pipeline::count()
+{
+    return results.size();
+}
+
+Result Pipeline::result(int i)
+{
+    assert(i >= 0 && i < static_cast<int>(results.size()));
+
+    if(results[i] == NULL) {
+        return Result();
+    }
+
+    PGresult* taken = results[i];
+    results[i] = NULL;
+
+    return Result(taken);
+}
+
+}
+}
@@ -0,0 +1,114 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+#include "parambuilder.h"
+#include "result.h"
+#include "statementcache.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Queries sent to the server one after another without waiting for results, in libpq pipeline mode
+  * thus a batch of queries takes a single round trip
+  * @verbatim
+  *     Pipeline p(connection);
+  *     p.pushParameter(1).queue("insert into foo values ($1)");
+  *     p.pushParameter(2).queue("insert into foo values ($1)");
+  *     p.sync();
+  *     p.queue("select count(*) from foo");
+  *     p();
+  *     Result count = p.result(2);
+  * @endverbatim
+  * Query failed on the server aborts the queries queued after it up to the next sync point (see `sync`),
+  * result of each aborted query has `PGRES_PIPELINE_ABORTED` status, queries after the sync point are executed.
+  * Outside of explicit transaction each sync point commits the queries before it.
+  *
+  * Query which statement was prepared on the connection (see `StatementCache`) is executed as the prepared statement,
+  * statements could be prepared with `prepare` before the first query is queued.
+  * Connection is kept in non blocking mode while pipeline is not finished, results are read while queries are
+  * being sent, thus neither side blocks on a full socket buffer.
+  * Connection which could not leave pipeline mode after it was broken is reset (see `PQreset`).
+  * Pipeline is not copyable and is not to be shared between threads
+  */
+class Pipeline
+{
+private:
+    enum Sent {
+        QUERY,
+        SYNC,
+        /** query that could not be sent, it has no result */
+        FAILED
+    };
+
+    PGconn* connection;
+    ParamBuilder parameters;
+    bool started;
+    bool broken;
+
+    /** queries and sync points in order they were sent */
+    std::vector<Sent> sent;
+    /** count of `sent` entries which results are read */
+    size_t received;
+    /** first result of a query which results are being read */
+    PGresult* current;
+    /** result of each query in order */
+    std::vector<PGresult*> results;
+
+    Pipeline(const Pipeline&);
+    const Pipeline& operator =(const Pipeline&);
+
+    void start();
+    /** sends a final sync point unless one was sent last, reads all results and leaves pipeline mode */
+    void finish();
+    /** sends queued data and reads results which are ready, waits for the socket if `wait` is set or send buffer is full */
+    void pump(bool wait);
+    void collect();
+    void release();
+
+public:
+    Pipeline(PGconn* _connection);
+    /** finishes pipeline, results which are not taken are freed */
+    ~Pipeline();
+
+    /** prepares statement for `sql` on the connection, to be called before the first query is queued,
+      * if `sql` could not be prepared its queries are sent as is and the error is in their results */
+    Pipeline& prepare(const std::string& sql);
+
+    /** @brief bind parameter of type `T` with value `value`
+      * to a subsequent query parameter. See `ParamBuilder` on
+      * how to extend this to User Defined Datatypes */
+    template <typename T>
+    Pipeline& pushParameter(T value);
+
+    /** queues `sql` with bound parameters and clears parameter list,
+      * query that could not be queued keeps its index and its result is not defined */
+    Pipeline& queue(const std::string& sql);
+
+    /** queues a sync point, failed query does not affect queries queued after the sync point */
+    Pipeline& sync();
+
+    /** sends a final sync point and waits for results of all queued queries, returns count of results,
+      * pipeline could be used once more after that */
+    int operator()();
+
+    /** count of results read so far */
+    int count();
+
+    /** takes result of `i`-th query (counting from 0 since the pipeline was run last time),
+      * result is not defined if it was taken already or connection was broken */
+    Result result(int i);
+};
+
+template <typename T>
+Pipeline& Pipeline::pushParameter(T value) {
+    parameters.push<T>(value);
+    return *this;
+}
+
+}
+}
+
+#endif // PIPELINE_H
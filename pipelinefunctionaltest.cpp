@@ -0,0 +1,90 @@
+#include "pipeline.h"
+#include "querytemplate.h"
+#include <gtest/gtest.h>
+#include "connection.h"
+#include "row.h"
+
+using namespace nkdhny::db;
+
+PGconn * getConnection() {
+
+        PGconn *conn = NULL;
+        conn = PQconnectdb("user=\'credentials\' password=\'credentials\' dbname=\'richquery\' hostaddr=\'127.0.0.1\' port=\'5432\' connect_timeout=5");
+        assert(conn != NULL);
+        assert(PQstatus(conn) == CONNECTION_OK);
+        return conn;
+}
+
+TEST(PipelineTest, MustReturnResultsInOrder) {
+    Connection<> c(getConnection());
+    Pipeline p(c);
+
+    for(int i = 0; i < 100; i++) {
+        p.pushParameter(i).queue("select $1::int as _int");
+    }
+
+    EXPECT_EQ(p(), 100);
+
+    for(int i = 0; i < 100; i++) {
+        Result r = p.result(i);
+        EXPECT_EQ(r.begin().get<int>("_int"), i);
+    }
+}
+
+TEST(PipelineTest, MustUsePreparedStatement) {
+    Connection<> c(getConnection());
+    Pipeline p(c);
+
+    p.prepare("select $1::bigint as _long");
+    p.pushParameter(static_cast<long>(1)).queue("select $1::bigint as _long");
+    p.pushParameter(static_cast<long>(2)).queue("select $1::bigint as _long");
+
+    EXPECT_EQ(p(), 2);
+    EXPECT_EQ(p.result(1).begin().get<long>("_long"), 2);
+    EXPECT_EQ(StatementCache::count(c), 1);
+}
+
+TEST(PipelineTest, MustIsolateFailureBySyncPoint) {
+    Connection<> c(getConnection());
+    QueryTemplate create(c, "create table t(i int);");
+    create();
+
+    {
+        Pipeline p(c);
+        p.pushParameter(1).queue("insert into t values ($1)");
+        p.sync();
+        p.queue("select 1/0");
+        p.pushParameter(2).queue("insert into t values ($1)");
+        p.sync();
+        p.pushParameter(3).queue("insert into t values ($1)");
+
+        EXPECT_EQ(p(), 4);
+        EXPECT_EQ(PQresultStatus(p.result(1).begin().res), PGRES_FATAL_ERROR);
+        EXPECT_EQ(PQresultStatus(p.result(2).begin().res), PGRES_PIPELINE_ABORTED);
+    }
+
+    QueryTemplate select(c, "select count(*)::int as _int from t;");
+    EXPECT_EQ(select().begin().get<int>("_int"), 2);
+
+    QueryTemplate drop(c, "drop table t;");
+    drop();
+}
+
+TEST(PipelineTest, MustFinishWhenDestroyedBeforeRun) {
+    Connection<> c(getConnection());
+
+    {
+        Pipeline p(c);
+        p.pushParameter(1).queue("select $1::int as _int");
+    }
+
+    EXPECT_EQ(PQpipelineStatus(c), PQ_PIPELINE_OFF);
+
+    QueryTemplate select(c, "select 1 as _int");
+    EXPECT_EQ(select().begin().get<int>("_int"), 1);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -10,6 +10,14 @@ PoolParams::PoolParams(int _capacity):
   min_idle = std::max(1, _capacity/10);
   max_idle = _capacity;
   retry = 0;
+  shards = 1;
+  validation_interval = 0;
+  lifo = false;
+  idle_timeout = 0;
+  max_lifetime = 0;
+  lifetime_jitter = 0;
+  maintenance_interval = 0;
+  reserved = 0;
 
   assert(capacity>0);
 }
@@ -19,7 +27,15 @@ PoolParams::PoolParams(int _capacity, int _min_idle, int _max_idle, int _retry,
   min_idle(_min_idle),
   max_idle(_max_idle),
   retry(_retry),
-  wait(_wait)
+  wait(_wait),
+  shards(1),
+  validation_interval(0),
+  lifo(false),
+  idle_timeout(0),
+  max_lifetime(0),
+  lifetime_jitter(0),
+  maintenance_interval(0),
+  reserved(0)
 {
   assert(capacity>0);
 }
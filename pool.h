@@ -2,11 +2,15 @@
 #define POOL_H
 
 #include "connection.h"
-#include <queue>
+#include <list>
+#include <vector>
+#include <algorithm>
 #include <assert.h>
-#include <unistd.h>
 #include <iostream>
 #include "lock.h"
+#include "atomic.h"
+#include "idlestore.h"
+#include "poolstats.h"
 #include "time.h"
 
 namespace nkdhny {
@@ -24,6 +28,29 @@ struct PoolParams {
   int max_idle;
   /** count to try recreate connection if freshly created one is NULL or not valid*/
   int retry;
+  /** count of independently locked parts idle connections are split into (see `IdleStore`),
+    * 1 by default; consider count of cores for pools shared by many threads */
+  int shards;
+  /** connection returned to the pool within this count of ms is given to a client without validation,
+    * 0 by default means connection is validated each time it is borrowed */
+  long validation_interval;
+  /** if set idle connections are given to clients in LIFO order, thus most recently used (the hottest) connection is reused
+    * and the rest are left to be reaped, by default (unset) connections are given in FIFO order */
+  bool lifo;
+  /** connection idle for more than this count of ms is destroyed unless there are `min_idle` or less idle connections,
+    * 0 by default means idle connections are never reaped */
+  long idle_timeout;
+  /** connection is destroyed after it was alive for this count of ms less random jitter
+    * up to `lifetime_jitter` ms, thus connections created at once are rotated gradually.
+    * 0 by default means connections live forever */
+  long max_lifetime;
+  long lifetime_jitter;
+  /** period in ms of a background maintainer thread that creates and destroys idle connections,
+    * 0 by default means no maintainer, connections are created and destroyed by clients */
+  long maintenance_interval;
+  /** count of connections out of `capacity` kept for clients of higher priority than `PRIORITY_BATCH`:
+    * batch client is given a connection only while more than `reserved` ones are not in use, 0 by default */
+  int reserved;
 
   explicit PoolParams(int _capacity);
   PoolParams(int _capacity, int _min_idle, int _max_idle, int _retry, long _wait);
@@ -39,6 +66,55 @@ struct PoolIsEmpty{};
   */
 struct PoolCouldNotCreateValidConnection{};
 
+/** count of transactions rolled back by passivate `action` to be shown in `PoolStats`,
+  * it is 0 unless an overload for the action type is found next to the type
+  * (see `poolactions::CheckTransactionStatusPassivate`) */
+template <typename Passivate>
+long countRollbacks(const Passivate&)
+{
+  return 0;
+}
+
+/** Priority class of a client borrowing a connection
+  * Waiting clients of a higher class are given connections first, clients of the same class in order they came,
+  * `PRIORITY_BATCH` clients are not given connections reserved for others (see `PoolParams::reserved`)
+  */
+enum Priority {
+  PRIORITY_CRITICAL = 0,
+  PRIORITY_NORMAL,
+  PRIORITY_BATCH,
+  PRIORITIES
+};
+
+/** Creation of several connections at once with `Create` action
+  * Generic version has `concurrent` unset and the pool creates connections one after another,
+  * one could specialize it for an action that is able to establish several connections concurrently
+  * (see `poolactions::PostgreCreate`) as follows:
+  * @verbatim
+  * template <>
+  * struct CreateBatch<FooCreate> {
+  *   static const bool concurrent = true;
+  *   static void create(FooCreate& action, int count, std::vector<PGconn*>& connections) {
+  *     action(count, connections);
+  *   }
+  * };
+  * @endverbatim
+  * `create` appends to `connections` no more than `count` established connections
+  */
+template <typename Create>
+struct CreateBatch {
+  static const bool concurrent = false;
+  static void create(Create& action, int count, std::vector<PGconn*>& connections);
+};
+
+template <typename Create>
+void CreateBatch<Create>::create(Create& action, int count, std::vector<PGconn*>& connections)
+{
+  for(int i = 0; i < count; i++) {
+    connections.push_back(action());
+  }
+}
+
 /** Action to be used for `nkdhny::db::Connection` to return its
   * underlying `PGcon*` to pool instead of closing it
   * @see nkdhny::db::Connection
@@ -55,12 +131,16 @@ template <typename C, typename V, typename A, typename P, typename D> struct Ret
   *
   * Main loop is as follows:
   * - cliaent asks pool for a object
-  * - pool checks if it has idle one if no wait for a `wait`ms timeout periodicaly checkking if idle connection appeared, if no exception `PoolIsEmpty` is throwed
-  * - pool validates object with `Validate` action if validation faild object is closed with `Destroy` action and recreated with `Create` action and validated again
+  * - pool checks if it has idle one if no client is queued and waits for at most `wait`ms (or until a deadline given by the client)
+  *   until some other client returns one, returned object is handed directly to the longest waiting client of the highest priority class
+  *   (see `Priority`), if no object was handed within timeout exception `PoolIsEmpty` is throwed
+  * - pool validates object with `Validate` action if validation faild object is closed with `Destroy` action and recreated with `Create` action and validated again,
+  *   validation is skipped for objects returned to the pool (or created) within last `validation_interval` ms
   * - pool activates object with `Activate` action
   * - client obtains `PooledConnection` object
   * - when destroyed `PooledConnection` will returned back to its pool by calling `Pool::push()` function
   * - pool wil passivate object with `Passivate` action
+  * - object older than its lifetime (see `max_lifetime`) is destroyed instead of being returned to the pool
   *
   * New object is created as follows:
   * - pool creates a fresh object with `Create` action
@@ -68,13 +148,21 @@ template <typename C, typename V, typename A, typename P, typename D> struct Ret
   * - if not - close object and try once more
   * - do it no more than `retry` times
   * - if was not able to create good connection - throw an exception `PoolCouldNotCreateValidConnection`
+  * If `CreateBatch` is specialized for `Create` action as concurrent, lacking idle connections are created
+  * in batches: all of them are established at once, and the failed ones are created by the next batch, no more than `retry` times
   *
   * Consistency checking and thread safety
   * If it is possible pool tryes to maintain at least `min_idle` but no more than `max_idle` connections
-  * this is done by calling `Pool::heat` and 'Pool::freeze' methods
-  * Main loop is syncronized, it means:
-  * - at a given time pool will give connection to only one client (instead of checking if connection is available, this action is concurrent)
-  * - at a given time only one cllient could return connection to a pool
+  * this is done by calling `Pool::heat` and 'Pool::freeze' methods, the latter also reaps connections that are idle for too long
+  * (see `idle_timeout`) or outlived their lifetime
+  * Idle connections are kept in `IdleStore` that is taken and returned to without the pool lock,
+  * the pool lock is held only to create or destroy connections and to queue waiting clients, it means:
+  * - a connection is given to only one client at a time
+  * - count of created connections never exceeds `capacity`
+  * - `Validate`, `Activate` and `Passivate` actions could be called concurrently for different connections
+  * If `maintenance_interval` is set, heating and freezing is done by a maintainer thread owned by the pool,
+  * clients only wake it up when idle connections are lacking or in excess, thus no client waits for `Create` action
+  * Pool counts its lifecycle events and durations of borrowing and holding connections without locking (see `Pool::stats`)
   * Constructor is not syncronized
   * it means that one could obtain inconsistent-partially constructed object when tryies to borrow object in concurrent thread just after creation of the pool
 */
@@ -94,8 +182,52 @@ protected:
   Passivate passivateAction;
   Destroy destroyAction;
 
-  int in_use_count;
-  std::queue<PGconn*> idle_connections;
+  volatile int in_use_count;
+  /** count of created and not yet destroyed connections, grows only under the pool lock */
+  volatile int total_count;
+  IdleStore idle_connections;
+
+  /** client blocked in `borrow` until some connection is handed to it by `push` */
+  struct Waiter {
+    IdleConnection connection;
+    Condition ready;
+
+    Waiter();
+  };
+
+  /** clients waiting for a connection by priority class, longest waiting first */
+  std::list<Waiter*> waiters[PRIORITIES];
+  /** total size of `waiters` to be checked without the pool lock */
+  volatile int waiting_count;
+  int reserved;
+
+  long validation_interval;
+  volatile long validations_elided;
+  volatile long validations_performed;
+
+  /** statistics, see `PoolStats` */
+  volatile long created_count;
+  volatile long create_failures;
+  volatile long validation_failures;
+  volatile long exhausted_count;
+  volatile long frozen_count;
+  Histogram borrow_wait;
+  Histogram hold_time;
+
+  long idle_timeout;
+  long max_lifetime;
+  long lifetime_jitter;
+  /** sequence to spread lifetimes of created connections */
+  volatile int lifetime_salt;
+  /** time idle connections were checked for expiration last time */
+  volatile long reaped_at;
+
+  long maintenance_interval;
+  pthread_t maintainer;
+  volatile bool stopping;
+  /** set by clients to wake up maintainer, cleared by maintainer */
+  volatile int maintenance_requested;
+  Condition maintenance_wanted;
 
   /**
     * no default constructor no copy
@@ -104,17 +236,39 @@ protected:
   Pool(const Pool&);
   const Pool& operator=(const Pool&);  
 
-  int count();
   int idle();
 
   /** object cration loop */
   PGconn* create() throw (PoolCouldNotCreateValidConnection);
+  /** creates and validates no more than `count` objects, concurrently if `CreateBatch` allows it */
+  void create(int count, std::vector<PGconn*>& created);
   void destroy(PGconn *c);
 
-  /** consistenty maintenance functions*/
+  /** consistenty maintenance functions, `heat` is to be called under the pool lock */
   void heat() throw (PoolCouldNotCreateValidConnection);
   void freeze();
 
+  /** time a connection created at `now` expires at, 0 if it lives forever */
+  long expiry(long now);
+  /** checks if it is time to look for expired idle connections, only one of concurrent clients gets true */
+  bool reapingDue(long now);
+
+  /** maintainer loop and its creation step, which does not hold the pool lock while creating */
+  static void* maintain(void* pool);
+  void replenish();
+  void requestMaintenance();
+
+  /** takes an idle connection without waiting if client of the `priority` is allowed to take one more,
+    * taken connection is counted as used */
+  IdleConnection take(Priority priority);
+
+  /** waiting functions, to be called under the pool lock */
+  IdleConnection await(long deadline, Priority priority) throw (PoolIsEmpty, PoolCouldNotCreateValidConnection);
+  /** first waiting client to be given a connection if `in_use` connections are used by others, `NULL` if there is no one */
+  Waiter* next(int in_use);
+  void handOff(Waiter* w, const IdleConnection& c);
+  void dispatch();
+
   bool consistent();
 
   Mutex lock;
@@ -123,7 +277,7 @@ protected:
   /** connactions ae going to be pusshed back not by client directly,
     * but by destructor of the `PooledConnection` class thus it is protected
     */
-  void push(PGconn* c);
+  void push(PGconn* c, long expires, long borrowed);
 
 public:
 
@@ -134,11 +288,29 @@ public:
   Pool(const PoolParams& params, Create _create, Validate _validate, Activate _activate, Passivate _passivate, Destroy _destroy) throw (PoolCouldNotCreateValidConnection);
   ~Pool();
 
-  /** Main loop */
+  /** Main loop, waits for at most `wait` ms */
   PooledConnection borrow() throw (PoolIsEmpty,  PoolCouldNotCreateValidConnection);
+  PooledConnection borrow(Priority priority) throw (PoolIsEmpty,  PoolCouldNotCreateValidConnection);
+  /** waits until `deadline`, time in ms as returned by `gettime_ms` */
+  PooledConnection borrow(long deadline, Priority priority = PRIORITY_NORMAL) throw (PoolIsEmpty,  PoolCouldNotCreateValidConnection);
   /** same as borrow */
   PooledConnection operator ()() throw (PoolIsEmpty, PoolCouldNotCreateValidConnection);
 
+  /** count of borrowed connections that were not validated as they were used recently */
+  long countValidationsElided();
+  /** count of borrowed connections that were validated with `Validate` action */
+  long countValidationsPerformed();
+
+  /** count of connections borrowed and not yet returned */
+  int countInUse();
+
+  /** count of connections which could not be created or were not valid when borrowed,
+    * it grows while the server is not healthy, even if the failures are handled by maintainer */
+  long countFailures();
+
+  /** current statistics of the pool */
+  PoolStats stats();
+
   /** action to be used for closing `PooledConnection` see bellow
     */
   friend struct ReturnToPoolAction<Create, Validate, Activate, Passivate, Destroy>;
@@ -151,23 +323,22 @@ public:
 template <typename C, typename V, typename A, typename P, typename D>
 struct ReturnToPoolAction: std::unary_function<PGconn*, void> {
   Pool<C, V, A, P, D>* pool;
-  explicit ReturnToPoolAction(Pool<C, V, A, P, D>* _pool = NULL);
+  /** time the connection expires at (see `PoolParams::max_lifetime`) */
+  long expires;
+  /** time in microseconds (see `gettime_us`) the connection was borrowed at */
+  long borrowed;
+  explicit ReturnToPoolAction(Pool<C, V, A, P, D>* _pool = NULL, long _expires = 0, long _borrowed = 0);
   void operator ()(PGconn* c);
 };
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
-int Pool<Create, Validate, Activate, Passivate, Destroy>::count()
-{
-  assert(in_use_count <= capacity);
-
-  return capacity - in_use_count;
-}
+Pool<Create, Validate, Activate, Passivate, Destroy>::Waiter::Waiter():
+  connection()
+{}
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 int Pool<Create, Validate, Activate, Passivate, Destroy>::idle()
 {
-  assert(idle_connections.size() <= capacity);
-
   return idle_connections.size();
 }
 
@@ -179,11 +350,14 @@ PGconn* Pool<Create, Validate, Activate, Passivate, Destroy>::create()  throw (P
   for(int i = 0; i <= retry; i++) {
     c = createAction();
     if(c == NULL){
+      atomicAdd(create_failures, 1L);
       continue;
     } else {
       if(validateAction(c)) {
+        atomicAdd(created_count, 1L);
         return c;
       } else {
+        atomicAdd(create_failures, 1L);
         destroyAction(c);
       }
     }
@@ -192,68 +366,400 @@ PGconn* Pool<Create, Validate, Activate, Passivate, Destroy>::create()  throw (P
   throw PoolCouldNotCreateValidConnection();
 }
 
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+void Pool<Create, Validate, Activate, Passivate, Destroy>::create(int count, std::vector<PGconn*>& created)
+{
+  if(!CreateBatch<Create>::concurrent) {
+    for(int i = 0; i < count; i++) {
+      try {
+        created.push_back(create());
+      } catch(PoolCouldNotCreateValidConnection&) {
+        return;
+      }
+    }
+    return;
+  }
+
+  int lacking = count;
+
+  for(int i = 0; i <= retry && lacking > 0; i++) {
+    std::vector<PGconn*> fresh;
+    CreateBatch<Create>::create(createAction, lacking, fresh);
+
+    atomicAdd(create_failures, static_cast<long>(lacking) - static_cast<long>(fresh.size()));
+
+    for(size_t j = 0; j < fresh.size(); j++) {
+      if(fresh[j] == NULL) {
+        atomicAdd(create_failures, 1L);
+        continue;
+      }
+
+      if(validateAction(fresh[j])) {
+        atomicAdd(created_count, 1L);
+        created.push_back(fresh[j]);
+        --lacking;
+      } else {
+        atomicAdd(create_failures, 1L);
+        destroyAction(fresh[j]);
+      }
+    }
+  }
+}
+
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 void Pool<Create, Validate, Activate, Passivate, Destroy>::destroy(PGconn* c)
 {
   destroyAction(c);
+  atomicAdd(total_count, -1);
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 void Pool<Create, Validate, Activate, Passivate, Destroy>::heat() throw (PoolCouldNotCreateValidConnection)
 {
-  int lack = std::min(min_idle - idle(), count() - idle());
+  int lack = std::min(min_idle - idle(), capacity - atomicGet(total_count));
 
   if(lack<=0) {
     return;
   }
 
-  for(int i =0; i< lack; i++) {
-    idle_connections.push(create());
+  std::vector<PGconn*> created;
+  create(lack, created);
+
+  long now = gettime_ms();
+
+  for(size_t i = 0; i < created.size(); i++) {
+    atomicAdd(total_count, 1);
+    idle_connections.push(IdleConnection(created[i], now, expiry(now)));
   }
 
-  assert(idle() <= capacity);
-  assert(idle() >= 0);
+  assert(atomicGet(total_count) <= capacity);
+
+  if(created.size() < static_cast<size_t>(lack)) {
+    throw PoolCouldNotCreateValidConnection();
+  }
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 void Pool<Create, Validate, Activate, Passivate, Destroy>::freeze()
 {
-  int excess = idle() - max_idle;
-  if(excess<=0){
-    return;
+  //excess is taken under the lock, thus concurrent returners and maintainer do not free the same excess twice,
+  //connections are destroyed without the lock
+  std::vector<PGconn*> excess;
+  if(idle() > max_idle) {
+    volatile Lock _lock(lock);
+
+    for(int i = idle() - max_idle; i>0; i--) {
+      IdleConnection c = idle_connections.pop();
+      if(c.connection == NULL) {
+        break;
+      }
+      excess.push_back(c.connection);
+    }
   }
 
-  for(int i = excess; i>0; i--) {
-    PGconn* c = idle_connections.front();
-    idle_connections.pop();
-    destroy(c);
+  for(size_t i = 0; i < excess.size(); i++) {
+    destroy(excess[i]);
+  }
+  atomicAdd(frozen_count, static_cast<long>(excess.size()));
+
+  if(idle_timeout > 0 || max_lifetime > 0) {
+    std::vector<PGconn*> reaped;
+    idle_connections.reap(gettime_ms(), idle_timeout, min_idle, reaped);
+
+    for(size_t i = 0; i < reaped.size(); i++) {
+      destroy(reaped[i]);
+    }
+    atomicAdd(frozen_count, static_cast<long>(reaped.size()));
+  }
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+long Pool<Create, Validate, Activate, Passivate, Destroy>::expiry(long now)
+{
+  if(max_lifetime <= 0) {
+    return 0;
+  }
+
+  long jitter = 0;
+  if(lifetime_jitter > 0) {
+    //multiplicative hash of the sequence number spreads jitters of connections created at once
+    unsigned long hash = static_cast<unsigned long>(atomicAdd(lifetime_salt, 1)) * 2654435761UL;
+    jitter = static_cast<long>((hash >> 8) % static_cast<unsigned long>(lifetime_jitter + 1));
   }
+
+  return now + max_lifetime - jitter;
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+bool Pool<Create, Validate, Activate, Passivate, Destroy>::reapingDue(long now)
+{
+  long period = idle_timeout > 0 ? idle_timeout/2 : max_lifetime/2;
+  if(period <= 0) {
+    return false;
+  }
+
+  long last = atomicGet(reaped_at);
+  return now - last >= period && atomicCompareAndSet(reaped_at, last, now);
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 bool Pool<Create, Validate, Activate, Passivate, Destroy>::consistent()
 {
-  bool idle_ok = idle()>=min_idle && idle()<=max_idle || count() < min_idle;
-  bool size_ok = (idle()+in_use_count) <= capacity;
-  bool used_ok = in_use_count>=0 && in_use_count <= capacity;
+  //counters are changed by clients concurrently, thus their sum is not checked, but each of idle and used
+  //connections is a created one: it is counted as used only once taken and it is not counted as created
+  //once destroyed, and total is read last as it is decreased only after a connection is destroyed
+  int used = atomicGet(in_use_count);
+  int idling = idle();
+  int total = atomicGet(total_count);
+
+  bool size_ok = total >= 0 && total <= capacity;
+  bool used_ok = used >= 0 && used <= total;
+  bool idle_ok = idling <= total;
+
+  return size_ok && used_ok && idle_ok;
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+IdleConnection Pool<Create, Validate, Activate, Passivate, Destroy>::await(long deadline, Priority priority) throw (PoolIsEmpty, PoolCouldNotCreateValidConnection)
+{
+  //pool could be drained by concurrent clients before it was heated
+  if(maintenance_interval > 0) {
+    //the pool lock is already held, thus maintainer is woken up directly
+    atomicCompareAndSet(maintenance_requested, 0, 1);
+    maintenance_wanted.Signal();
+  } else {
+    heat();
+  }
+
+  Waiter w;
+  waiters[priority].push_back(&w);
+  atomicAdd(waiting_count, 1);
+
+  //connection could be returned by a client that has not seen this one queued,
+  //it is given to clients in order, thus this one could be served or not
+  dispatch();
+
+  //handed connection is already counted as used
+  while(w.connection.connection == NULL) {
+    if(!w.ready.Wait(lock, deadline) && w.connection.connection == NULL) {
+      waiters[priority].remove(&w);
+      atomicAdd(waiting_count, -1);
+      atomicAdd(exhausted_count, 1L);
+      throw PoolIsEmpty();
+    }
+  }
+
+  return w.connection;
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+IdleConnection Pool<Create, Validate, Activate, Passivate, Destroy>::take(Priority priority)
+{
+  if(priority != PRIORITY_BATCH || reserved == 0) {
+    IdleConnection c = idle_connections.pop();
+    if(c.connection != NULL) {
+      atomicAdd(in_use_count, 1);
+    }
+    return c;
+  }
+
+  //batch client counts itself only if it is still allowed to once it has taken a connection,
+  //thus concurrent ones never take reserved connections and only taken connections are counted as used
+  IdleConnection c = idle_connections.pop();
+  if(c.connection == NULL) {
+    return c;
+  }
+
+  while(true) {
+    int used = atomicGet(in_use_count);
+    if(used >= capacity - reserved) {
+      idle_connections.push(c);
+      return IdleConnection();
+    }
+    if(atomicCompareAndSet(in_use_count, used, used + 1)) {
+      return c;
+    }
+  }
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+typename Pool<Create, Validate, Activate, Passivate, Destroy>::Waiter* Pool<Create, Validate, Activate, Passivate, Destroy>::next(int in_use)
+{
+  for(int p = PRIORITY_CRITICAL; p < PRIORITIES; p++) {
+    if(waiters[p].empty()) {
+      continue;
+    }
+    if(p == PRIORITY_BATCH && in_use >= capacity - reserved) {
+      return NULL;
+    }
+    return waiters[p].front();
+  }
+
+  return NULL;
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+void Pool<Create, Validate, Activate, Passivate, Destroy>::handOff(Waiter* w, const IdleConnection& c)
+{
+  for(int p = PRIORITY_CRITICAL; p < PRIORITIES; p++) {
+    if(!waiters[p].empty() && waiters[p].front() == w) {
+      waiters[p].pop_front();
+      break;
+    }
+  }
+  atomicAdd(waiting_count, -1);
 
-  return size_ok && idle_ok && used_ok;
+  w->connection = c;
+  w->ready.Signal();
 }
+
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
-void Pool<Create, Validate, Activate, Passivate, Destroy>::push(PGconn *c)
+void Pool<Create, Validate, Activate, Passivate, Destroy>::dispatch()
 {
+  Waiter* w = NULL;
+
+  while((w = next(atomicGet(in_use_count))) != NULL) {
+    IdleConnection c = idle_connections.pop();
+    if(c.connection == NULL) {
+      return;
+    }
+
+    atomicAdd(in_use_count, 1);
+    handOff(w, c);
+  }
+}
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+void Pool<Create, Validate, Activate, Passivate, Destroy>::push(PGconn *c, long expires, long borrowed)
+{
+  hold_time.record(gettime_us() - borrowed);
 
   passivateAction(c);
-  {
+
+  bool timed = validation_interval > 0 || idle_timeout > 0 || max_lifetime > 0;
+  long now = timed ? gettime_ms() : 0;
+
+  IdleConnection returned(c, now, expires);
+
+  if(atomicGet(waiting_count) > 0) {
     volatile Lock _lock(lock);
 
+    Waiter* w = next(atomicGet(in_use_count) - 1);
+    if(w != NULL) {
+      //connection stays in use, it is just handed to the other client
+      handOff(w, returned);
+      return;
+    }
+  }
+
+  atomicAdd(in_use_count, -1);
+
+  if(expires > 0 && expires <= now) {
+    //connection is rotated, lacking one is created by next heating
+    destroy(c);
+
+    if(maintenance_interval > 0 && idle() < min_idle) {
+      requestMaintenance();
+    }
+    return;
+  }
+
+  idle_connections.push(returned);
+
+  //some client could be queued while connection was being returned
+  if(atomicGet(waiting_count) > 0) {
+    volatile Lock _lock(lock);
+
+    dispatch();
+
     assert(consistent());
+  }
 
-    --in_use_count;
-    idle_connections.push(c);
+  if(maintenance_interval > 0) {
+    if(idle() > max_idle) {
+      requestMaintenance();
+    }
+  } else if(idle() > max_idle || (timed && reapingDue(now))) {
     freeze();
+  }
+}
 
-    assert(consistent());
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+void Pool<Create, Validate, Activate, Passivate, Destroy>::requestMaintenance()
+{
+  //lock is taken only by the client that sets request, others see it already set
+  if(atomicCompareAndSet(maintenance_requested, 0, 1)) {
+    volatile Lock _lock(lock);
+    maintenance_wanted.Signal();
+  }
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+void Pool<Create, Validate, Activate, Passivate, Destroy>::replenish()
+{
+  int lack = 0;
+  {
+    volatile Lock _lock(lock);
+
+    lack = std::min(min_idle - idle(), capacity - atomicGet(total_count));
+    if(lack <= 0) {
+      return;
+    }
+
+    //capacity is reserved before creation, thus lock is not held while creating
+    atomicAdd(total_count, lack);
+  }
+
+  //connections that could not be established concurrently are given to waiting clients as soon as each is created
+  int step = CreateBatch<Create>::concurrent ? lack : 1;
+
+  for(int i = 0; i < lack; i += step) {
+    std::vector<PGconn*> created;
+    create(step, created);
+
+    long now = gettime_ms();
+
+    for(size_t j = 0; j < created.size(); j++) {
+      idle_connections.push(IdleConnection(created[j], now, expiry(now)));
+    }
+
+    if(atomicGet(waiting_count) > 0) {
+      volatile Lock _lock(lock);
+      dispatch();
+    }
+
+    if(created.size() < static_cast<size_t>(step)) {
+      //waiting clients will get `PoolIsEmpty`, next attempt is done on next maintenance
+      atomicAdd(total_count, static_cast<int>(created.size()) - (lack - i));
+      return;
+    }
+  }
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+void* Pool<Create, Validate, Activate, Passivate, Destroy>::maintain(void* arg)
+{
+  Pool* pool = reinterpret_cast<Pool*>(arg);
+
+  while(true) {
+    {
+      volatile Lock _lock(pool->lock);
+
+      long deadline = gettime_ms() + pool->maintenance_interval;
+
+      while(!pool->stopping && !atomicCompareAndSet(pool->maintenance_requested, 1, 0)) {
+        if(!pool->maintenance_wanted.Wait(pool->lock, deadline)) {
+          break;
+        }
+      }
+
+      if(pool->stopping) {
+        return NULL;
+      }
+    }
+
+    //connections reaped by freezing are replaced at once
+    pool->freeze();
+    pool->replenish();
   }
 }
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
@@ -263,15 +769,43 @@ Pool<Create, Validate, Activate, Passivate, Destroy>::Pool(const PoolParams &par
   min_idle(params.min_idle),
   max_idle(params.max_idle),
   retry(params.retry),
-  in_use_count(0),
-  idle_connections(),
   createAction(_create),
   validateAction(_validate),
   activateAction(_activate),
   passivateAction(_passivate),
-  destroyAction(_destroy)
+  destroyAction(_destroy),
+  in_use_count(0),
+  total_count(0),
+  idle_connections(params.shards, params.lifo),
+  waiting_count(0),
+  reserved(params.reserved),
+  validation_interval(params.validation_interval),
+  validations_elided(0),
+  validations_performed(0),
+  created_count(0),
+  create_failures(0),
+  validation_failures(0),
+  exhausted_count(0),
+  frozen_count(0),
+  borrow_wait(),
+  hold_time(),
+  idle_timeout(params.idle_timeout),
+  max_lifetime(params.max_lifetime),
+  lifetime_jitter(params.lifetime_jitter),
+  lifetime_salt(0),
+  reaped_at(0),
+  maintenance_interval(params.maintenance_interval),
+  stopping(false),
+  maintenance_requested(0)
 {
+  assert(reserved >= 0 && reserved < capacity);
+
   heat();
+
+  //if maintainer could not be started the pool is maintained by its clients, as if there were no maintenance interval
+  if(maintenance_interval > 0 && pthread_create(&maintainer, NULL, maintain, this) != 0) {
+    maintenance_interval = 0;
+  }
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
@@ -279,49 +813,119 @@ Pool<Create, Validate, Activate, Passivate, Destroy>::~Pool()
 {
   assert(in_use_count == 0);
 
-  while(!idle_connections.empty()){
-    destroyAction(idle_connections.front());
-    idle_connections.pop();
+  if(maintenance_interval > 0) {
+    {
+      volatile Lock _lock(lock);
+      stopping = true;
+      maintenance_wanted.Signal();
+    }
+    pthread_join(maintainer, NULL);
+  }
+
+  IdleConnection c;
+  while((c = idle_connections.pop()).connection != NULL){
+    destroyAction(c.connection);
   }
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 typename Pool<Create, Validate, Activate, Passivate, Destroy>::PooledConnection Pool<Create, Validate, Activate, Passivate, Destroy>::borrow()  throw (PoolIsEmpty,  PoolCouldNotCreateValidConnection)
 {
-  long started = gettime_ms();
-  long will_end = started+wait;
-  long sleep_for = wait/10;
+  return borrow(gettime_ms()+wait, PRIORITY_NORMAL);
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+typename Pool<Create, Validate, Activate, Passivate, Destroy>::PooledConnection Pool<Create, Validate, Activate, Passivate, Destroy>::borrow(Priority priority)  throw (PoolIsEmpty,  PoolCouldNotCreateValidConnection)
+{
+  return borrow(gettime_ms()+wait, priority);
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+typename Pool<Create, Validate, Activate, Passivate, Destroy>::PooledConnection Pool<Create, Validate, Activate, Passivate, Destroy>::borrow(long deadline, Priority priority)  throw (PoolIsEmpty,  PoolCouldNotCreateValidConnection)
+{
+  long started = gettime_us();
+
+  PGconn* c = NULL;
+  long expires = 0;
 
-  do {
-    if(idle()>0) {
+  while(c == NULL) {
+    IdleConnection taken;
 
+    //client does not overtake queued ones
+    if(atomicGet(waiting_count) == 0) {
+      taken = take(priority);
+    }
+
+    if(taken.connection == NULL) {
       volatile Lock _lock(lock);
+      taken = await(deadline, priority);
+    }
 
-      assert(consistent());
+    c = taken.connection;
+    expires = taken.expires;
 
-      PGconn* c = idle_connections.front();
-      idle_connections.pop();
+    if(expires > 0 && expires <= gettime_ms()) {
+      //connection has outlived its lifetime, client takes the next one
+      atomicAdd(in_use_count, -1);
+      destroy(c);
+      c = NULL;
+      continue;
+    }
 
-      if(!validateAction(c)) {
-        destroyAction(c);
+    if(validation_interval > 0 && gettime_ms() - taken.returned < validation_interval) {
+      atomicAdd(validations_elided, 1L);
+      break;
+    }
+
+    atomicAdd(validations_performed, 1L);
+
+    if(validateAction(c)) {
+      break;
+    }
+
+    atomicAdd(validation_failures, 1L);
+    destroyAction(c);
+
+    if(maintenance_interval > 0) {
+      //broken connection is replaced by maintainer, client takes the next one
+      atomicAdd(in_use_count, -1);
+      atomicAdd(total_count, -1);
+      requestMaintenance();
+      c = NULL;
+    } else {
+      try {
         c = create();
+        expires = expiry(gettime_ms());
+      } catch(PoolCouldNotCreateValidConnection&) {
+        atomicAdd(in_use_count, -1);
+        atomicAdd(total_count, -1);
+        throw;
       }
+    }
+  }
 
-      activateAction(c);
-      ++in_use_count;
+  activateAction(c);
 
-      heat();
+  long borrowed = gettime_us();
+  borrow_wait.record(borrowed - started);
 
-      assert(consistent());
+  //connection goes back to the pool if heating fails
+  PooledConnection pooled(c, ReturnToPoolAction<Create, Validate, Activate, Passivate, Destroy>(this, expires, borrowed));
 
-      return PooledConnection(c, ReturnToPoolAction<Create, Validate, Activate, Passivate, Destroy>(this));
-    }
+  if(idle() < min_idle && atomicGet(total_count) < capacity) {
+    if(maintenance_interval > 0) {
+      requestMaintenance();
+    } else {
+      volatile Lock _lock(lock);
 
-    usleep(sleep_for*1000); //sleep_for is in milliseconds
+      heat();
+      dispatch();
 
-  } while(gettime_ms() < will_end);
+      assert(consistent());
+    }
+  }
 
-  throw PoolIsEmpty();
+  return pooled;
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
@@ -331,15 +935,66 @@ typename Pool<Create, Validate, Activate, Passivate, Destroy>::PooledConnection
 }
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
-ReturnToPoolAction<Create, Validate, Activate, Passivate, Destroy>::ReturnToPoolAction(Pool<Create, Validate, Activate, Passivate, Destroy>* _pool):
-  pool(_pool)
+long Pool<Create, Validate, Activate, Passivate, Destroy>::countValidationsElided()
+{
+  return atomicGet(validations_elided);
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+long Pool<Create, Validate, Activate, Passivate, Destroy>::countValidationsPerformed()
+{
+  return atomicGet(validations_performed);
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+int Pool<Create, Validate, Activate, Passivate, Destroy>::countInUse()
+{
+  return atomicGet(in_use_count);
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+long Pool<Create, Validate, Activate, Passivate, Destroy>::countFailures()
+{
+  return atomicGet(create_failures) + atomicGet(validation_failures);
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+PoolStats Pool<Create, Validate, Activate, Passivate, Destroy>::stats()
+{
+  PoolStats s;
+
+  s.idle = idle();
+  s.in_use = atomicGet(in_use_count);
+  s.total = atomicGet(total_count);
+  s.waiting = atomicGet(waiting_count);
+
+  s.created = atomicGet(created_count);
+  s.create_failures = atomicGet(create_failures);
+  s.validations_performed = atomicGet(validations_performed);
+  s.validations_elided = atomicGet(validations_elided);
+  s.validation_failures = atomicGet(validation_failures);
+  s.exhausted = atomicGet(exhausted_count);
+  s.frozen = atomicGet(frozen_count);
+  s.rollbacks = countRollbacks(passivateAction);
+
+  s.borrow_wait = borrow_wait.snapshot();
+  s.hold = hold_time.snapshot();
+
+  return s;
+}
+
+template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
+ReturnToPoolAction<Create, Validate, Activate, Passivate, Destroy>::ReturnToPoolAction(Pool<Create, Validate, Activate, Passivate, Destroy>* _pool, long _expires, long _borrowed):
+  pool(_pool),
+  expires(_expires),
+  borrowed(_borrowed)
 {}
 
 template <typename Create, typename Validate, typename Activate, typename Passivate, typename Destroy>
 void ReturnToPoolAction<Create, Validate, Activate, Passivate, Destroy>::operator ()(PGconn *c)
 {
   if(pool !=NULL){
-    pool->push(c);
+    pool->push(c, expires, borrowed);
   }
 }
 
@@ -1,9 +1,17 @@
 #include "poolactions.h"
+#include "time.h"
+#include "atomic.h"
+#include "statementcache.h"
+#include <poll.h>
+#include <errno.h>
+#include <sys/socket.h>
 
 namespace nkdhny {
 namespace db {
 namespace poolactions {
 
+const int PostgreCreate::CONNECT_TIMEOUT = 5;
+
 PostgreCreate::PostgreCreate(std::string _host, std::string _database, std::string _role, std::string _password, int _port):
   host(_host),
   database(_database),
@@ -17,16 +25,104 @@ PGconn *PostgreCreate::operator ()()
   PGconn *conn = NULL;
   std::stringstream connectionString;
 
-  connectionString << "user='"<<role<<"' password='"<<password<<"' dbname='"<<database<<"' hostaddr='"<<host<<"' port='"<<port<<"' connect_timeout=5";
+  connectionString << "user='"<<role<<"' password='"<<password<<"' dbname='"<<database<<"' hostaddr='"<<host<<"' port='"<<port<<"' connect_timeout="<<CONNECT_TIMEOUT;
 
   conn = PQconnectdb(connectionString.str().c_str());
-  assert(conn != NULL);
-  assert(PQstatus(conn) == CONNECTION_OK);
+
+  //pool treats NULL as a failure to create connection and retries
+  if(conn != NULL && PQstatus(conn) != CONNECTION_OK) {
+    PQfinish(conn);
+    return NULL;
+  }
+
   return conn;
 }
 
-QueryValidate::QueryValidate(std::string _validator):
-  validator(_validator)
+void PostgreCreate::operator ()(int count, std::vector<PGconn*>& connections)
+{
+  std::stringstream portString;
+  std::stringstream timeoutString;
+  portString << port;
+  timeoutString << CONNECT_TIMEOUT;
+
+  std::string portValue = portString.str();
+  std::string timeoutValue = timeoutString.str();
+
+  const char* keywords[] = {"user", "password", "dbname", "hostaddr", "port", "connect_timeout", NULL};
+  const char* values[] = {role.c_str(), password.c_str(), database.c_str(), host.c_str(), portValue.c_str(), timeoutValue.c_str(), NULL};
+
+  std::vector<PGconn*> pending;
+  std::vector<PostgresPollingStatusType> polling;
+
+  for(int i = 0; i < count; i++) {
+    PGconn* conn = PQconnectStartParams(keywords, values, 0);
+
+    if(conn == NULL) {
+      continue;
+    }
+    if(PQstatus(conn) == CONNECTION_BAD) {
+      PQfinish(conn);
+      continue;
+    }
+
+    pending.push_back(conn);
+    //libpq requires to act as if polling returned writing before the first call
+    polling.push_back(PGRES_POLLING_WRITING);
+  }
+
+  long deadline = gettime_ms() + CONNECT_TIMEOUT*1000;
+
+  while(!pending.empty()) {
+    long remains = deadline - gettime_ms();
+    if(remains <= 0) {
+      break;
+    }
+
+    //socket of a connection could change while connecting, thus descriptors are collected each time
+    std::vector<pollfd> descriptors(pending.size());
+    for(size_t i = 0; i < pending.size(); i++) {
+      descriptors[i].fd = PQsocket(pending[i]);
+      descriptors[i].events = polling[i] == PGRES_POLLING_READING ? POLLIN : POLLOUT;
+      descriptors[i].revents = 0;
+    }
+
+    int ready = poll(&descriptors[0], descriptors.size(), static_cast<int>(remains));
+    if(ready < 0 && errno != EINTR) {
+      break;
+    }
+
+    for(size_t i = descriptors.size(); i > 0; i--) {
+      size_t j = i - 1;
+      if(descriptors[j].revents == 0) {
+        continue;
+      }
+
+      polling[j] = PQconnectPoll(pending[j]);
+
+      if(polling[j] == PGRES_POLLING_OK || polling[j] == PGRES_POLLING_FAILED) {
+        if(polling[j] == PGRES_POLLING_OK) {
+          connections.push_back(pending[j]);
+        } else {
+          PQfinish(pending[j]);
+        }
+
+        pending.erase(pending.begin() + j);
+        polling.erase(polling.begin() + j);
+      }
+    }
+  }
+
+  for(size_t i = 0; i < pending.size(); i++) {
+    PQfinish(pending[i]);
+  }
+}
+
+QueryValidate::QueryValidate(std::string _validator, bool _probe):
+  validator(_validator),
+  probe(_probe),
+  probed_valid(0),
+  probed_broken(0),
+  queried(0)
 {}
 
 bool QueryValidate::operator ()(PGconn *c)
@@ -35,17 +131,48 @@ bool QueryValidate::operator ()(PGconn *c)
     return false;
   }
 
+  if(probe) {
+    char byte;
+    ssize_t received = recv(PQsocket(c), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    //idle connection could have unsolicited messages, like notices or the error server sends before it
+    //closes the connection, they are consumed and the socket is probed once more
+    if(received > 0) {
+      if(PQconsumeInput(c) != 1 || PQstatus(c) != CONNECTION_OK) {
+        atomicAdd(probed_broken, 1L);
+        return false;
+      }
+      received = recv(PQsocket(c), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    }
+
+    if(received == 0) {
+      atomicAdd(probed_broken, 1L);
+      return false;
+    }
+    if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      atomicAdd(probed_valid, 1L);
+      return true;
+    }
+  }
+
+  atomicAdd(queried, 1L);
+
   Query q(c, validator);
   Result r = q();
 
   return r.begin() != r.end();
 }
 
+CheckTransactionStatusPassivate::CheckTransactionStatusPassivate():
+  rollbacks(0)
+{}
+
 void CheckTransactionStatusPassivate::operator ()(PGconn *c)
 {
   PGTransactionStatusType transaction_status = PQtransactionStatus(c);
 
   if(transaction_status == PQTRANS_INTRANS || transaction_status == PQTRANS_INERROR || transaction_status == PQTRANS_UNKNOWN) {
+    atomicAdd(rollbacks, 1L);
     Query rollback(c, "rollback transaction;");
     rollback();
   }
@@ -53,6 +180,7 @@ void CheckTransactionStatusPassivate::operator ()(PGconn *c)
 
 void FreeConnectionDestroy::operator ()(PGconn *c)
 {
+  StatementCache::purge(c);
   PQfinish(c);
 }
 
@@ -2,12 +2,14 @@
 #define POOLACTIONS_H
 
 #include "query.h"
+#include "pool.h"
+#include <vector>
 
 namespace nkdhny {
 namespace db {
 namespace poolactions {
 
-/** libpq connection factory, creates a new connection*/
+/** libpq connection factory, creates a new connection, or returns `NULL` if connection could not be established */
 struct PostgreCreate: std::unary_function<void, PGconn*> {
   std::string host;
   std::string database;
@@ -15,18 +17,38 @@ struct PostgreCreate: std::unary_function<void, PGconn*> {
   std::string password;
   int port;
 
+  /** seconds to wait for connection to be established */
+  static const int CONNECT_TIMEOUT;
+
   PostgreCreate(std::string _host, std::string _database, std::string _role, std::string _password, int _port);
 
   PGconn* operator()();
+
+  /** establishes `count` connections at once with non blocking libpq connection functions
+    * it takes about a time of a single connection handshake, connections that failed or were
+    * not established within `CONNECT_TIMEOUT` are closed and are not appended to `connections` */
+  void operator()(int count, std::vector<PGconn*>& connections);
 };
 
 /** validation functor. it checks that connection status is fine
   * and it is possible to make a simple query with this connection
+  * If `probe` is set connection socket is checked first without blocking:
+  * - if server has closed the connection it is not valid
+  * - if there is nothing to read from the socket connection is valid
+  * - if there is something to read (e.g. server notice) the validation query is executed
+  * Counters show how often each of the checks decided
   */
 struct QueryValidate: std::unary_function<PGconn*, bool> {
   std::string validator;
+  bool probe;
+
+  /** connections found valid or broken by probing the socket */
+  volatile long probed_valid;
+  volatile long probed_broken;
+  /** connections validated with the validation query */
+  volatile long queried;
 
-  QueryValidate(std::string _validator);
+  QueryValidate(std::string _validator, bool _probe = false);
 
   bool operator ()(PGconn* c);
 };
@@ -41,15 +63,36 @@ struct StubActivate: std::unary_function<PGconn*, void> {
   * if transaction was started and not finished or transaction is in error
   * or has unknown status transaction will rolled back */
 struct CheckTransactionStatusPassivate:std::unary_function<PGconn*, void> {
+  /** count of rolled back transactions */
+  volatile long rollbacks;
+
+  CheckTransactionStatusPassivate();
+
   void operator()(PGconn* c);
 };
 
-/** libpq connection free*/
+/** rollbacks counted by the action, shown by `Pool::stats` */
+inline long countRollbacks(const CheckTransactionStatusPassivate& passivate) {
+  __sync_synchronize();
+  return passivate.rollbacks;
+}
+
+/** libpq connection free, statements cached for the connection are forgotten (see `StatementCache`) */
 struct FreeConnectionDestroy: std::unary_function<PGconn*, void> {
   void operator()(PGconn* c);
 };
 
 }
+
+/** `PostgreCreate` establishes connections of a batch concurrently */
+template <>
+struct CreateBatch<poolactions::PostgreCreate> {
+  static const bool concurrent = true;
+  static void create(poolactions::PostgreCreate& action, int count, std::vector<PGconn*>& connections) {
+    action(count, connections);
+  }
+};
+
 }
 }
 
@@ -3,6 +3,8 @@
 #include <string>
 #include "transaction.h"
 #include "querytemplate.h"
+#include <poll.h>
+#include <unistd.h>
 
 static const std::string host = "127.0.0.1";
 static const std::string database = "richquery";
@@ -25,6 +27,19 @@ TEST(PoolActions, shouldCreateAndFreeConnectionProperly) {
   EXPECT_EQ(CONNECTION_BAD, PQstatus(conn));
 }
 
+TEST(PoolActions, shouldCreateSeveralConnectionsAtOnce) {
+  std::vector<PGconn*> connections;
+  create(5, connections);
+
+  EXPECT_EQ(5, connections.size());
+
+  for(size_t i = 0; i < connections.size(); i++) {
+    EXPECT_EQ(CONNECTION_OK, PQstatus(connections[i]));
+    EXPECT_TRUE(validate_true(connections[i]));
+    destroy(connections[i]);
+  }
+}
+
 TEST(PoolActions, shouldValidateConnection) {
   PGconn* conn = create();
 
@@ -34,6 +49,35 @@ TEST(PoolActions, shouldValidateConnection) {
   destroy(conn);
 }
 
+TEST(PoolActions, shouldValidateConnectionByProbingSocket) {
+  PGconn* conn = create();
+
+  nkdhny::db::poolactions::QueryValidate probe("select 1", true);
+
+  EXPECT_TRUE(probe(conn));
+  EXPECT_EQ(1, probe.probed_valid);
+  EXPECT_EQ(0, probe.queried);
+
+  //backend is killed by other connection, thus the probed one does not see it until it reads the socket
+  PGconn* killer = create();
+  nkdhny::db::Query kill(killer, "select pg_terminate_backend($1)");
+  kill.pushParameter(PQbackendPID(conn))();
+  destroy(killer);
+
+  pollfd closed;
+  closed.fd = PQsocket(conn);
+  closed.events = POLLIN;
+  ASSERT_EQ(1, poll(&closed, 1, 5000));
+  usleep(100*1000);
+
+  EXPECT_EQ(CONNECTION_OK, PQstatus(conn));
+  EXPECT_FALSE(probe(conn));
+  EXPECT_EQ(1, probe.probed_broken);
+  EXPECT_EQ(0, probe.queried);
+
+  destroy(conn);
+}
+
 TEST(PoolActions, sholdRollbackUnfinishedTransaction) {
   PGconn* c = create();
 
@@ -0,0 +1,186 @@
+#include "pool.h"
+#include "poolfakes.h"
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Measures throughput and latency of borrowing and returning a connection
+  * Each run is a combination of:
+  * - count of client threads, 1..`max_threads` by powers of two
+  * - ratio of pool capacity to count of threads
+  * - idle store sharding, a single lock or a shard per core
+  * - delays of fake create and validate actions
+  * Connections are fake, thus without delays only the pool itself is measured.
+  * Results are printed to stdout as a JSON document, a run per element of `runs`
+  *
+  * usage: poolbench [max_threads] [duration_ms]
+  */
+
+typedef nkdhny::db::Pool<FakeConnectionCreator, FakeConnectionValidator, Nothing, Nothing, Nothing> BenchPool;
+
+struct Delays {
+  const char* name;
+  /** ms */
+  long create;
+  long validate;
+};
+
+struct Run {
+  int threads;
+  double ratio;
+  int capacity;
+  int shards;
+  Delays delays;
+
+  long operations;
+  long failed;
+  double ops;
+  /** latencies in us */
+  long p50;
+  long p90;
+  long p99;
+  long p999;
+  long max;
+};
+
+struct Worker {
+  BenchPool* pool;
+  volatile bool* stop;
+  long failed;
+  /** latency of each borrow and return in us */
+  std::vector<long> latencies;
+};
+
+static void* work(void* arg) {
+  Worker* w = reinterpret_cast<Worker*>(arg);
+
+  while(!nkdhny::atomicGet(*w->stop)) {
+    long start = nkdhny::gettime_us();
+
+    try {
+      volatile BenchPool::PooledConnection c = w->pool->borrow();
+    } catch(nkdhny::db::PoolIsEmpty&) {
+      ++w->failed;
+      continue;
+    } catch(nkdhny::db::PoolCouldNotCreateValidConnection&) {
+      ++w->failed;
+      continue;
+    }
+
+    w->latencies.push_back(nkdhny::gettime_us() - start);
+  }
+
+  return NULL;
+}
+
+static long percentile(std::vector<long>& sorted, double q) {
+  if(sorted.empty()) {
+    return 0;
+  }
+
+  size_t rank = static_cast<size_t>(q * (sorted.size() - 1));
+  return sorted[rank];
+}
+
+static void run(Run& r, long duration) {
+  FakeConnectionCreator::somethingVeryGoodHappend();
+  FakeConnectionCreator::delay = r.delays.create;
+  FakeConnectionValidator::delay = r.delays.validate;
+
+  nkdhny::db::PoolParams params(r.capacity, std::max(1, r.capacity/2), r.capacity, 0, 1000);
+  params.shards = r.shards;
+
+  BenchPool pool(params, FakeConnectionCreator(), FakeConnectionValidator(), Nothing(), Nothing(), Nothing());
+
+  volatile bool stop = false;
+  std::vector<pthread_t> ids(r.threads);
+  std::vector<Worker> workers(r.threads);
+
+  long start = nkdhny::gettime_us();
+
+  for(int i = 0; i < r.threads; i++) {
+    workers[i].pool = &pool;
+    workers[i].stop = &stop;
+    workers[i].failed = 0;
+    pthread_create(&ids[i], NULL, work, &workers[i]);
+  }
+
+  usleep(duration*1000);
+  stop = true;
+  __sync_synchronize();
+
+  std::vector<long> latencies;
+  r.failed = 0;
+
+  for(int i = 0; i < r.threads; i++) {
+    pthread_join(ids[i], NULL);
+    r.failed += workers[i].failed;
+    latencies.insert(latencies.end(), workers[i].latencies.begin(), workers[i].latencies.end());
+  }
+
+  long elapsed = std::max(1L, nkdhny::gettime_us() - start);
+
+  std::sort(latencies.begin(), latencies.end());
+
+  r.operations = latencies.size();
+  r.ops = 1000000.0 * r.operations / elapsed;
+  r.p50 = percentile(latencies, 0.5);
+  r.p90 = percentile(latencies, 0.9);
+  r.p99 = percentile(latencies, 0.99);
+  r.p999 = percentile(latencies, 0.999);
+  r.max = latencies.empty() ? 0 : latencies.back();
+}
+
+static void print(const Run& r, bool last) {
+  printf("    {\"threads\": %d, \"capacity_ratio\": %.2f, \"capacity\": %d, \"shards\": %d, "
+         "\"delays\": \"%s\", \"create_delay_ms\": %ld, \"validate_delay_ms\": %ld, "
+         "\"operations\": %ld, \"failed\": %ld, \"ops_per_sec\": %.0f, "
+         "\"latency_us\": {\"p50\": %ld, \"p90\": %ld, \"p99\": %ld, \"p999\": %ld, \"max\": %ld}}%s\n",
+         r.threads, r.ratio, r.capacity, r.shards,
+         r.delays.name, r.delays.create, r.delays.validate,
+         r.operations, r.failed, r.ops,
+         r.p50, r.p90, r.p99, r.p999, r.max, last ? "" : ",");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+
+  int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+  long duration = argc > 2 ? atol(argv[2]) : 200;
+  int cores = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+
+  double ratios[] = {0.5, 1, 2};
+  int shard_counts[] = {1, std::max(2, cores)};
+  Delays delays[] = {{"none", 0, 0}, {"slow", 5, 1}};
+
+  std::vector<Run> runs;
+
+  for(int threads = 1; threads <= max_threads; threads *= 2) {
+    for(size_t i = 0; i < sizeof(ratios)/sizeof(ratios[0]); i++) {
+      for(size_t j = 0; j < sizeof(shard_counts)/sizeof(shard_counts[0]); j++) {
+        for(size_t k = 0; k < sizeof(delays)/sizeof(delays[0]); k++) {
+          Run r;
+          r.threads = threads;
+          r.ratio = ratios[i];
+          r.capacity = std::max(1, static_cast<int>(threads * ratios[i]));
+          r.shards = shard_counts[j];
+          r.delays = delays[k];
+          runs.push_back(r);
+        }
+      }
+    }
+  }
+
+  printf("{\n  \"benchmark\": \"pool\",\n  \"cores\": %d,\n  \"duration_ms\": %ld,\n  \"runs\": [\n", cores, duration);
+
+  for(size_t i = 0; i < runs.size(); i++) {
+    run(runs[i], duration);
+    print(runs[i], i + 1 == runs.size());
+  }
+
+  printf("  ]\n}\n");
+
+  return 0;
+}
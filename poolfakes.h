@@ -0,0 +1,135 @@
+#ifndef POOLFAKES_H
+#define POOLFAKES_H
+
+#include "pool.h"
+#include "atomic.h"
+#include <unistd.h>
+
+/** Pool actions that do not need a server, to be used by unit tests and benchmarks
+  * Static members are defined here, thus the header is to be included by a single translation unit of an executable
+  * Counters are atomic as pool calls actions from many threads
+  */
+
+static int _fake_valid = 1;
+static int _fake_invalid = 0;
+
+static PGconn* fake_valid_connection    = reinterpret_cast<PGconn*>(&_fake_valid);
+static PGconn* fake_invalid_connection  = reinterpret_cast<PGconn*>(&_fake_invalid);
+static PGconn* fake_null_connection = NULL;
+
+
+struct FakeConnectionCreator: std::unary_function<void, PGconn*> {
+
+  enum FakeFactoryState{
+    VALID,
+    INVALID,
+    NULLC
+  };
+
+  static FakeFactoryState state;
+  static int counter;
+  /** ms to wait before connection is created */
+  static long delay;
+
+  PGconn* operator()() {
+
+    nkdhny::atomicAdd(counter, 1);
+
+    if(delay > 0) {
+      usleep(delay*1000);
+    }
+
+    switch(state) {
+    case VALID:
+      return fake_valid_connection;
+    case INVALID:
+      return fake_invalid_connection;
+    default:
+      return fake_null_connection;
+    }
+
+  }
+
+  static void somethingVeryBadHappend() {
+    state = INVALID;
+  }
+
+  static void somethingVeryGoodHappend() {
+    state = VALID;
+  }
+
+  static void faktoryDisapeared() {
+    state = NULLC;
+  }
+
+};
+FakeConnectionCreator::FakeFactoryState FakeConnectionCreator::state = FakeConnectionCreator::VALID;
+int FakeConnectionCreator::counter = 0;
+long FakeConnectionCreator::delay = 0;
+
+struct Counter: std::unary_function<PGconn*, void> {
+
+  int counter;
+  static int staticCounter;
+
+  Counter():
+    counter(0)
+  {}
+
+  void operator ()(PGconn*){
+    nkdhny::atomicAdd(counter, 1);
+    nkdhny::atomicAdd(staticCounter, 1);
+  }
+};
+int Counter::staticCounter = 0;
+
+struct StaticCounter: std::unary_function<PGconn*, void> {
+
+  static int counter;
+
+  StaticCounter()
+  {}
+
+  void operator ()(PGconn*){
+    nkdhny::atomicAdd(StaticCounter::counter, 1);
+  }
+};
+int StaticCounter::counter = 0;
+
+struct FakeConnectionValidator: std::unary_function<PGconn*, bool> {
+
+  int counter;
+  static int staticCounter;
+  /** ms to wait before connection is validated */
+  static long delay;
+
+  FakeConnectionValidator():
+    counter(0)
+  {}
+
+  bool operator()(PGconn* c) {
+    nkdhny::atomicAdd(counter, 1);
+    nkdhny::atomicAdd(staticCounter, 1);
+
+    if(delay > 0) {
+      usleep(delay*1000);
+    }
+
+    return *(reinterpret_cast<int*>(c)) == 1;
+  }
+};
+
+int FakeConnectionValidator::staticCounter = 0;
+long FakeConnectionValidator::delay = 0;
+
+struct AlwaysValid: std::unary_function<PGconn*, bool> {
+  bool operator()(PGconn*) {
+    return true;
+  }
+};
+
+struct Nothing: std::unary_function<PGconn*, void> {
+  void operator()(PGconn*) {}
+};
+
+#endif // POOLFAKES_H
@@ -0,0 +1,131 @@
+#include "poolstats.h"
+#include "atomic.h"
+
+namespace nkdhny {
+namespace db {
+
+HistogramSnapshot::HistogramSnapshot():
+  buckets(Histogram::BUCKETS, 0),
+  count(0),
+  sum(0)
+{}
+
+long HistogramSnapshot::bound(int bucket)
+{
+  return 1L << bucket;
+}
+
+long HistogramSnapshot::quantile(double q) const
+{
+  if(count == 0) {
+    return 0;
+  }
+
+  long rank = static_cast<long>(q * count);
+  if(rank < 1) {
+    rank = 1;
+  }
+
+  long seen = 0;
+  for(size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if(seen >= rank) {
+      return bound(i);
+    }
+  }
+
+  return bound(buckets.size() - 1);
+}
+
+Histogram::Histogram():
+  sum(0)
+{
+  for(int i = 0; i < BUCKETS; i++) {
+    buckets[i] = 0;
+  }
+}
+
+void Histogram::record(long us)
+{
+  int bucket = 0;
+  if(us > 0) {
+    bucket = static_cast<int>(sizeof(long)*8) - __builtin_clzl(static_cast<unsigned long>(us));
+  } else {
+    us = 0;
+  }
+
+  if(bucket >= BUCKETS) {
+    bucket = BUCKETS - 1;
+  }
+
+  atomicAdd(buckets[bucket], 1L);
+  atomicAdd(sum, us);
+}
+
+HistogramSnapshot Histogram::snapshot()
+{
+  HistogramSnapshot s;
+
+  for(int i = 0; i < BUCKETS; i++) {
+    s.buckets[i] = atomicGet(buckets[i]);
+    s.count += s.buckets[i];
+  }
+  s.sum = atomicGet(sum);
+
+  return s;
+}
+
+PoolStats::PoolStats():
+  idle(0),
+  in_use(0),
+  total(0),
+  waiting(0),
+  created(0),
+  create_failures(0),
+  validations_performed(0),
+  validations_elided(0),
+  validation_failures(0),
+  exhausted(0),
+  frozen(0),
+  rollbacks(0),
+  borrow_wait(),
+  hold()
+{}
+
+static void exposeHistogram(std::ostream& out, const std::string& name, const HistogramSnapshot& h)
+{
+  long cumulative = 0;
+
+  for(size_t i = 0; i + 1 < h.buckets.size(); i++) {
+    cumulative += h.buckets[i];
+    //bucket holds values less than its bound, exposed bounds are inclusive
+    out << name << "_bucket{le=\"" << HistogramSnapshot::bound(i) - 1 << "\"} " << cumulative << "\n";
+  }
+
+  out << name << "_bucket{le=\"+Inf\"} " << h.count << "\n";
+  out << name << "_sum " << h.sum << "\n";
+  out << name << "_count " << h.count << "\n";
+}
+
+void PoolStats::expose(std::ostream &out, const std::string &prefix) const
+{
+  out << prefix << "_idle " << idle << "\n";
+  out << prefix << "_in_use " << in_use << "\n";
+  out << prefix << "_total " << total << "\n";
+  out << prefix << "_waiting " << waiting << "\n";
+
+  out << prefix << "_created_total " << created << "\n";
+  out << prefix << "_create_failures_total " << create_failures << "\n";
+  out << prefix << "_validations_performed_total " << validations_performed << "\n";
+  out << prefix << "_validations_elided_total " << validations_elided << "\n";
+  out << prefix << "_validation_failures_total " << validation_failures << "\n";
+  out << prefix << "_exhausted_total " << exhausted << "\n";
+  out << prefix << "_frozen_total " << frozen << "\n";
+  out << prefix << "_rollbacks_total " << rollbacks << "\n";
+
+  exposeHistogram(out, prefix + "_borrow_wait_us", borrow_wait);
+  exposeHistogram(out, prefix + "_hold_us", hold);
+}
+
+}
+}
@@ -0,0 +1,88 @@
+#ifndef POOLSTATS_H
+#define POOLSTATS_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+namespace nkdhny {
+namespace db {
+
+/** Copy of `Histogram` values at some moment */
+struct HistogramSnapshot {
+  /** `buckets[i]` is count of values in range [`bound(i-1)`, `bound(i)`) */
+  std::vector<long> buckets;
+  /** count of recorded values, equals to the sum of `buckets` */
+  long count;
+  /** sum of recorded values */
+  long sum;
+
+  HistogramSnapshot();
+
+  /** upper bound (exclusive) of the `bucket`, the last bucket is unbounded */
+  static long bound(int bucket);
+  /** upper bound of the bucket holding `q` quantile (0 < q <= 1), 0 if nothing was recorded */
+  long quantile(double q) const;
+};
+
+/** Lock free histogram of durations in microseconds with power of two buckets.
+  * Recording is an atomic increment of a bucket and an atomic add to the sum,
+  * thus it could be done by many threads concurrently
+  */
+class Histogram {
+public:
+  static const int BUCKETS = 32;
+
+  Histogram();
+
+  void record(long us);
+  HistogramSnapshot snapshot();
+
+private:
+  volatile long buckets[BUCKETS];
+  volatile long sum;
+
+  Histogram(const Histogram&);
+  const Histogram& operator=(const Histogram&);
+};
+
+/** Statistics of a pool (see `Pool::stats`)
+  * Each value is read atomically, but values are not read at once, thus values recorded while statistics
+  * are taken could be seen by some of them only, e.g. by a histogram bucket but not by its sum
+  */
+struct PoolStats {
+  /** gauges */
+  int idle;
+  int in_use;
+  int total;
+  int waiting;
+
+  /** counters since the pool was created */
+  long created;
+  long create_failures;
+  long validations_performed;
+  long validations_elided;
+  long validation_failures;
+  /** count of `PoolIsEmpty` thrown */
+  long exhausted;
+  /** count of idle connections destroyed by freezing, i.e. in excess of `max_idle`, idle for too long or expired */
+  long frozen;
+  /** count of transactions rolled back while passivating, if passivate action counts them */
+  long rollbacks;
+
+  /** time in microseconds clients waited in `borrow` */
+  HistogramSnapshot borrow_wait;
+  /** time in microseconds connections were held by clients */
+  HistogramSnapshot hold;
+
+  PoolStats();
+
+  /** plain text exposition, a line per value `<prefix>_<name>[{le="<bound>"}] <value>`,
+    * histograms are exposed as cumulative buckets like a monitoring system (e.g. Prometheus) expects */
+  void expose(std::ostream& out, const std::string& prefix = "richquery_pool") const;
+};
+
+}
+}
+
+#endif // POOLSTATS_H
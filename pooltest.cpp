@@ -1,113 +1,24 @@
 #include "pool.h"
+#include "poolfakes.h"
 #include "gtest/gtest.h"
-
-static int _fake_valid = 1;
-static int _fake_invalid = 0;
-
-static PGconn* fake_valid_connection    = reinterpret_cast<PGconn*>(&_fake_valid);
-static PGconn* fake_invalid_connection  = reinterpret_cast<PGconn*>(&_fake_invalid);
-static PGconn* fake_null_connection = NULL;
+#include <unistd.h>
+#include <sstream>
 
 static const int pool_size = 10;
 static const int idle_size = 2;
 static const int retry_count = 3;
 static const long timeout = 100;
 
-struct FakeConnectionCreator: std::unary_function<void, PGconn*> {
-
-  enum FakeFactoryState{
-    VALID,
-    INVALID,
-    NULLC
-  };
-
-  static FakeFactoryState state;
-  static int counter;
-
-  PGconn* operator()() {
-
-    ++counter;
-
-    switch(state) {
-    case VALID:
-      return fake_valid_connection;
-    case INVALID:
-      return fake_invalid_connection;
-    default:
-      return fake_null_connection;
-    }
-
-  }
-
-  static void somethingVeryBadHappend() {
-    state = INVALID;
-  }
-
-  static void somethingVeryGoodHappend() {
-    state = VALID;
-  }
-
-  static void faktoryDisapeared() {
-    state = NULLC;
-  }
-
-};
-FakeConnectionCreator::FakeFactoryState FakeConnectionCreator::state = FakeConnectionCreator::VALID;
-int FakeConnectionCreator::counter = 0;
-
-struct Counter: std::unary_function<PGconn*, void> {
-
-  int counter;
-  static int staticCounter;
-
-  Counter():
-    counter(0)
-  {}
-
-  void operator ()(PGconn* c){
-    ++counter;
-    ++staticCounter;
-  }
-};
-int Counter::staticCounter = 0;
-
-struct StaticCounter: std::unary_function<PGconn*, void> {
-
-  static int counter;
-
-  StaticCounter()
-  {}
-
-  void operator ()(PGconn*){
-    ++StaticCounter::counter;
-  }
-};
-int StaticCounter::counter = 0;
-
-struct FakeConnectionValidator: std::unary_function<PGconn*, bool> {
-
-  int counter;
-  static int staticCounter;
-
-  FakeConnectionValidator():
-    counter(0)
-  {}
-
-  bool operator()(PGconn* c) {
-    ++counter;
-    ++staticCounter;
-    return *(reinterpret_cast<int*>(c)) == 1;
-  }
-};
-
-int FakeConnectionValidator::staticCounter = 0;
-
 class TestPool: public nkdhny::db::Pool<FakeConnectionCreator, FakeConnectionValidator, Counter, Counter, StaticCounter> {
 public:
   TestPool():
     nkdhny::db::Pool<FakeConnectionCreator, FakeConnectionValidator, Counter, Counter, StaticCounter>(nkdhny::db::PoolParams(pool_size, idle_size, pool_size, retry_count-1, timeout), FakeConnectionCreator(), FakeConnectionValidator(), Counter(), Counter(), StaticCounter())
   {}
 
+  TestPool(const nkdhny::db::PoolParams& params):
+    nkdhny::db::Pool<FakeConnectionCreator, FakeConnectionValidator, Counter, Counter, StaticCounter>(params, FakeConnectionCreator(), FakeConnectionValidator(), Counter(), Counter(), StaticCounter())
+  {}
+
   int countCreated() {
     return createAction.counter;
   }
@@ -123,6 +34,10 @@ public:
   int countPassivated() {
     return passivateAction.counter;
   }
+
+  int countIdle() {
+    return idle();
+  }
 };
 
 TEST(PoolTest, happyPass) {
@@ -252,6 +167,536 @@ TEST(PoolTest, shouldTrowAnExceptionWhenExhausted) {
 
 }
 
+struct BorrowInThread {
+  TestPool* pool;
+  nkdhny::db::Priority priority;
+  /** ms to hold borrowed connection */
+  long hold;
+  bool borrowed;
+  long waited;
+};
+
+static void* borrowInThread(void* arg) {
+  BorrowInThread* b = reinterpret_cast<BorrowInThread*>(arg);
+  long start = nkdhny::gettime_ms();
+
+  try {
+    volatile TestPool::PooledConnection c = b->pool->borrow(b->priority);
+    b->borrowed = true;
+    b->waited = nkdhny::gettime_ms() - start;
+    usleep(b->hold*1000);
+    return NULL;
+  } catch(nkdhny::db::PoolIsEmpty&) {
+    b->borrowed = false;
+  }
+
+  b->waited = nkdhny::gettime_ms() - start;
+  return NULL;
+}
+
+TEST(PoolTest, shouldHandReturnedConnectionToWaitingClient) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+  FakeConnectionCreator::counter = 0;
+  FakeConnectionValidator::staticCounter = 0;
+  Counter::staticCounter = 0;
+  StaticCounter::counter = 0;
+  {
+    TestPool p;
+
+    std::vector<TestPool::PooledConnection> all;
+
+    for(int i = 0; i < pool_size; i++) {
+      all.push_back(p.borrow());
+    }
+
+    BorrowInThread b;
+    b.pool = &p;
+    b.priority = nkdhny::db::PRIORITY_NORMAL;
+    b.hold = 0;
+    b.borrowed = false;
+    b.waited = 0;
+
+    pthread_t t;
+    pthread_create(&t, NULL, borrowInThread, &b);
+
+    usleep(timeout/4*1000);
+    all.pop_back();
+
+    pthread_join(t, NULL);
+
+    EXPECT_TRUE(b.borrowed);
+    EXPECT_TRUE(b.waited < timeout/2);
+
+    EXPECT_EQ(p.countCreated() , pool_size);
+    EXPECT_EQ(p.countActivated() , pool_size+1);
+    EXPECT_EQ(p.countPassivated() , 2);
+
+    while(!all.empty()) {
+      all.pop_back();
+    }
+  }
+
+  EXPECT_EQ(StaticCounter::counter , pool_size);
+}
+
+TEST(PoolTest, shouldHandReturnedConnectionToClientOfHigherPriorityFirst) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+
+  nkdhny::db::PoolParams params(2, 1, 1, retry_count-1, timeout);
+
+  {
+    TestPool p(params);
+
+    std::vector<TestPool::PooledConnection> all;
+    all.push_back(p.borrow());
+    all.push_back(p.borrow());
+
+    BorrowInThread batch = {&p, nkdhny::db::PRIORITY_BATCH, 0, false, 0};
+    BorrowInThread critical = {&p, nkdhny::db::PRIORITY_CRITICAL, timeout, false, 0};
+
+    pthread_t batch_thread, critical_thread;
+    pthread_create(&batch_thread, NULL, borrowInThread, &batch);
+    usleep(timeout/10*1000);
+    pthread_create(&critical_thread, NULL, borrowInThread, &critical);
+    usleep(timeout/10*1000);
+
+    EXPECT_EQ(p.stats().waiting, 2);
+
+    //critical client came later but is served first and holds connection until batch one gives up
+    all.pop_back();
+
+    pthread_join(batch_thread, NULL);
+    pthread_join(critical_thread, NULL);
+
+    EXPECT_TRUE(critical.borrowed);
+    EXPECT_TRUE(critical.waited < timeout/2);
+    EXPECT_FALSE(batch.borrowed);
+    EXPECT_EQ(p.stats().exhausted, 1);
+  }
+}
+
+TEST(PoolTest, shouldKeepReservedConnectionsFromBatchClients) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+
+  nkdhny::db::PoolParams params(3, 1, 3, retry_count-1, timeout);
+  params.reserved = 1;
+
+  {
+    TestPool p(params);
+
+    std::list<TestPool::PooledConnection> all;
+    all.push_back(p.borrow(nkdhny::db::PRIORITY_BATCH));
+    all.push_back(p.borrow(nkdhny::db::PRIORITY_BATCH));
+
+    EXPECT_THROW(p.borrow(nkdhny::db::PRIORITY_BATCH), nkdhny::db::PoolIsEmpty);
+
+    all.push_back(p.borrow());
+    EXPECT_EQ(p.stats().in_use, 3);
+
+    //batch client is given a connection only if `reserved` ones are left idle
+    all.pop_front();
+    EXPECT_THROW(p.borrow(nkdhny::db::PRIORITY_BATCH), nkdhny::db::PoolIsEmpty);
+
+    all.pop_back();
+    all.push_back(p.borrow(nkdhny::db::PRIORITY_BATCH));
+    EXPECT_EQ(p.stats().in_use, 2);
+  }
+}
+
+TEST(PoolTest, shouldWaitUntilDeadlineGivenByClient) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+
+  nkdhny::db::PoolParams params(1, 1, 1, retry_count-1, 10*timeout);
+
+  {
+    TestPool p(params);
+    TestPool::PooledConnection c = p.borrow();
+
+    long start = nkdhny::gettime_ms();
+    EXPECT_THROW(p.borrow(start + timeout), nkdhny::db::PoolIsEmpty);
+    long end = nkdhny::gettime_ms();
+
+    EXPECT_TRUE(end-start >= timeout);
+    EXPECT_TRUE(end-start < 2*timeout);
+
+    EXPECT_THROW(p.borrow(start), nkdhny::db::PoolIsEmpty);
+  }
+}
+
+TEST(PoolTest, shouldNotValidateRecentlyUsedConnection) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+  FakeConnectionCreator::counter = 0;
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, timeout);
+  params.validation_interval = 10*timeout;
+
+  {
+    TestPool p(params);
+    EXPECT_EQ(p.countValidated() , idle_size);
+
+    {
+      volatile TestPool::PooledConnection c = p.borrow();
+    }
+    {
+      volatile TestPool::PooledConnection c = p.borrow();
+    }
+
+    //the only validation is done for the connection created while heating
+    EXPECT_EQ(p.countValidated() , idle_size+1);
+    EXPECT_EQ(p.countValidationsElided() , 2);
+    EXPECT_EQ(p.countValidationsPerformed() , 0);
+  }
+
+  params.validation_interval = 0;
+
+  {
+    TestPool p(params);
+
+    {
+      volatile TestPool::PooledConnection c = p.borrow();
+    }
+
+    EXPECT_EQ(p.countValidationsElided() , 0);
+    EXPECT_EQ(p.countValidationsPerformed() , 1);
+  }
+}
+
+TEST(PoolTest, shouldCountBorrowsHoldsAndExhaustion) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+  FakeConnectionCreator::counter = 0;
+
+  nkdhny::db::PoolParams params(2, 1, 1, retry_count-1, timeout);
+
+  {
+    TestPool p(params);
+
+    {
+      TestPool::PooledConnection first = p.borrow();
+      TestPool::PooledConnection second = p.borrow();
+
+      nkdhny::db::PoolStats s = p.stats();
+      EXPECT_EQ(s.in_use, 2);
+      EXPECT_EQ(s.total, 2);
+      EXPECT_EQ(s.created, 2);
+      EXPECT_EQ(s.borrow_wait.count, 2);
+      EXPECT_EQ(s.hold.count, 0);
+
+      EXPECT_THROW(p.borrow(), nkdhny::db::PoolIsEmpty);
+      usleep(1000);
+    }
+
+    nkdhny::db::PoolStats s = p.stats();
+    EXPECT_EQ(s.in_use, 0);
+    EXPECT_EQ(s.idle, 1);
+    EXPECT_EQ(s.frozen, 1);
+    EXPECT_EQ(s.exhausted, 1);
+    EXPECT_EQ(s.create_failures, 0);
+    EXPECT_EQ(s.hold.count, 2);
+    EXPECT_TRUE(s.hold.sum >= 2*1000);
+    EXPECT_TRUE(s.hold.quantile(0.5) > 1000);
+
+    std::ostringstream out;
+    s.expose(out);
+    EXPECT_NE(out.str().find("richquery_pool_exhausted_total 1\n"), std::string::npos);
+    EXPECT_NE(out.str().find("richquery_pool_hold_us_count 2\n"), std::string::npos);
+    EXPECT_NE(out.str().find("richquery_pool_borrow_wait_us_bucket{le=\"+Inf\"} 2\n"), std::string::npos);
+  }
+}
+
+TEST(PoolTest, maintainerShouldCreateConnectionsOutOfBorrowPath) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+  FakeConnectionCreator::counter = 0;
+  StaticCounter::counter = 0;
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, timeout);
+  params.maintenance_interval = timeout/10;
+
+  {
+    TestPool p(params);
+    EXPECT_EQ(p.countCreated() , idle_size);
+
+    FakeConnectionCreator::delay = timeout;
+
+    long start = nkdhny::gettime_ms();
+    {
+      volatile TestPool::PooledConnection c = p.borrow();
+      EXPECT_TRUE(nkdhny::gettime_ms() - start < timeout/2);
+
+      usleep(2*timeout*1000);
+
+      EXPECT_EQ(FakeConnectionCreator::counter , idle_size+1);
+      EXPECT_EQ(p.countIdle() , idle_size);
+    }
+
+    FakeConnectionCreator::delay = 0;
+  }
+
+  EXPECT_EQ(StaticCounter::counter , idle_size+1);
+}
+
+TEST(PoolTest, shouldCountFailuresHandledByMaintainer) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, timeout);
+  params.maintenance_interval = timeout/10;
+
+  {
+    TestPool p(params);
+    long failures = p.countFailures();
+
+    //idle connections are broken and none could be created, maintainer replaces them in vain
+    _fake_valid = 0;
+    FakeConnectionCreator::somethingVeryBadHappend();
+
+    EXPECT_THROW(p.borrow(), nkdhny::db::PoolIsEmpty);
+    EXPECT_GT(p.countFailures(), failures);
+
+    _fake_valid = 1;
+    FakeConnectionCreator::somethingVeryGoodHappend();
+  }
+}
+
+struct FakeBatchCreator: std::unary_function<void, PGconn*> {
+
+  static int batches;
+  static int counter;
+
+  PGconn* operator()() {
+    ++counter;
+    return fake_valid_connection;
+  }
+
+  void operator()(int count, std::vector<PGconn*>& connections) {
+    ++batches;
+    for(int i = 0; i < count; i++) {
+      connections.push_back((*this)());
+    }
+  }
+};
+int FakeBatchCreator::batches = 0;
+int FakeBatchCreator::counter = 0;
+
+namespace nkdhny {
+namespace db {
+
+template <>
+struct CreateBatch<FakeBatchCreator> {
+  static const bool concurrent = true;
+  static void create(FakeBatchCreator& action, int count, std::vector<PGconn*>& connections) {
+    action(count, connections);
+  }
+};
+
+}
+}
+
+TEST(PoolTest, shouldCreateLackingConnectionsInASingleBatch) {
+
+  FakeBatchCreator::batches = 0;
+  FakeBatchCreator::counter = 0;
+
+  nkdhny::db::PoolParams params(pool_size, pool_size/2, pool_size, retry_count-1, timeout);
+
+  {
+    nkdhny::db::Pool<FakeBatchCreator, AlwaysValid, Nothing, Nothing, Nothing> p(params, FakeBatchCreator(), AlwaysValid(), Nothing(), Nothing(), Nothing());
+
+    EXPECT_EQ(FakeBatchCreator::batches , 1);
+    EXPECT_EQ(FakeBatchCreator::counter , pool_size/2);
+  }
+}
+
+/** creates a new distinct valid connection each time */
+struct DistinctConnectionCreator: std::unary_function<void, PGconn*> {
+
+  static int connections[4*pool_size];
+  static int counter;
+
+  PGconn* operator()() {
+    int* c = &connections[counter++ % (4*pool_size)];
+    *c = 1;
+    return reinterpret_cast<PGconn*>(c);
+  }
+};
+int DistinctConnectionCreator::connections[4*pool_size];
+int DistinctConnectionCreator::counter = 0;
+
+class DistinctTestPool: public nkdhny::db::Pool<DistinctConnectionCreator, AlwaysValid, Nothing, Nothing, StaticCounter> {
+public:
+  DistinctTestPool(const nkdhny::db::PoolParams& params):
+    nkdhny::db::Pool<DistinctConnectionCreator, AlwaysValid, Nothing, Nothing, StaticCounter>(params, DistinctConnectionCreator(), AlwaysValid(), Nothing(), Nothing(), StaticCounter())
+  {}
+
+  int countIdle() {
+    return idle();
+  }
+};
+
+TEST(PoolTest, shouldReuseTheHottestConnectionWhenLifo) {
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, timeout);
+  params.lifo = true;
+
+  {
+    DistinctTestPool p(params);
+
+    PGconn* first = NULL;
+    {
+      DistinctTestPool::PooledConnection c = p.borrow();
+      first = c;
+    }
+
+    DistinctTestPool::PooledConnection c = p.borrow();
+    EXPECT_EQ(first, static_cast<PGconn*>(c));
+  }
+
+  params.lifo = false;
+
+  {
+    DistinctTestPool p(params);
+
+    PGconn* first = NULL;
+    {
+      DistinctTestPool::PooledConnection c = p.borrow();
+      first = c;
+    }
+
+    DistinctTestPool::PooledConnection c = p.borrow();
+    EXPECT_NE(first, static_cast<PGconn*>(c));
+  }
+}
+
+TEST(PoolTest, shouldReapIdleConnections) {
+
+  StaticCounter::counter = 0;
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, timeout);
+  params.idle_timeout = timeout/2;
+
+  {
+    DistinctTestPool p(params);
+
+    {
+      std::vector<DistinctTestPool::PooledConnection> all;
+      for(int i = 0; i < pool_size/2; i++) {
+        all.push_back(p.borrow());
+      }
+    }
+
+    int idle = p.countIdle();
+    EXPECT_TRUE(idle > idle_size);
+
+    usleep(timeout*1000);
+
+    {
+      volatile DistinctTestPool::PooledConnection c = p.borrow();
+    }
+
+    EXPECT_EQ(p.countIdle() , idle_size);
+    EXPECT_EQ(StaticCounter::counter , idle - idle_size);
+  }
+}
+
+TEST(PoolTest, shouldDestroyConnectionThatOutlivedItsLifetime) {
+
+  StaticCounter::counter = 0;
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, timeout);
+  params.max_lifetime = timeout/2;
+  params.lifetime_jitter = timeout/4;
+
+  {
+    DistinctTestPool p(params);
+
+    {
+      volatile DistinctTestPool::PooledConnection c = p.borrow();
+      usleep(timeout*1000);
+    }
+
+    //borrowed one is rotated on return, the idle ones are rotated when they are taken
+    EXPECT_EQ(StaticCounter::counter , 1);
+
+    int destroyed = StaticCounter::counter;
+    {
+      volatile DistinctTestPool::PooledConnection c = p.borrow();
+    }
+
+    EXPECT_EQ(StaticCounter::counter , destroyed + idle_size);
+  }
+}
+
+class ShardedTestPool: public nkdhny::db::Pool<FakeConnectionCreator, AlwaysValid, Nothing, Nothing, Nothing> {
+public:
+  ShardedTestPool(const nkdhny::db::PoolParams& params):
+    nkdhny::db::Pool<FakeConnectionCreator, AlwaysValid, Nothing, Nothing, Nothing>(params, FakeConnectionCreator(), AlwaysValid(), Nothing(), Nothing(), Nothing())
+  {}
+
+  int countTotal() {
+    return total_count;
+  }
+};
+
+struct BorrowLoop {
+  ShardedTestPool* pool;
+  int iterations;
+  int failed;
+};
+
+static void* borrowLoop(void* arg) {
+  BorrowLoop* l = reinterpret_cast<BorrowLoop*>(arg);
+
+  for(int i = 0; i < l->iterations; i++) {
+    try {
+      volatile ShardedTestPool::PooledConnection c = l->pool->borrow();
+    } catch(nkdhny::db::PoolIsEmpty&) {
+      ++l->failed;
+    }
+  }
+
+  return NULL;
+}
+
+TEST(PoolTest, shardedPoolShouldKeepAccountingExact) {
+
+  FakeConnectionCreator::somethingVeryGoodHappend();
+  FakeConnectionCreator::counter = 0;
+
+  const int threads = 2*pool_size;
+
+  nkdhny::db::PoolParams params(pool_size, idle_size, pool_size, retry_count-1, 10*timeout);
+  params.shards = 4;
+
+  {
+    ShardedTestPool p(params);
+
+    std::vector<pthread_t> ids(threads);
+    std::vector<BorrowLoop> loops(threads);
+
+    for(int i = 0; i < threads; i++) {
+      loops[i].pool = &p;
+      loops[i].iterations = 1000;
+      loops[i].failed = 0;
+      pthread_create(&ids[i], NULL, borrowLoop, &loops[i]);
+    }
+
+    for(int i = 0; i < threads; i++) {
+      pthread_join(ids[i], NULL);
+      EXPECT_EQ(loops[i].failed, 0);
+    }
+
+    EXPECT_EQ(p.countInUse(), 0);
+    EXPECT_TRUE(p.countTotal() <= pool_size);
+    EXPECT_EQ(p.countTotal(), FakeConnectionCreator::counter);
+  }
+}
+
 int main(int argc, char **argv) {
 
   srand (time(NULL));
@@ -3,10 +3,15 @@
 namespace nkdhny {
 namespace db {
 
-PostgrePool::PostgrePool(PostgreConnectionParams connectionParams, PoolParams params):
-  Pool(params, poolactions::PostgreCreate(connectionParams.host, connectionParams.database, connectionParams.role, connectionParams.password, connectionParams.port), poolactions::QueryValidate("select 1"), poolactions::StubActivate(), poolactions::CheckTransactionStatusPassivate(), poolactions::FreeConnectionDestroy())
+PostgrePool::PostgrePool(PostgreConnectionParams connectionParams, PoolParams params, bool probe):
+  Pool(params, poolactions::PostgreCreate(connectionParams.host, connectionParams.database, connectionParams.role, connectionParams.password, connectionParams.port), poolactions::QueryValidate("select 1", probe), poolactions::StubActivate(), poolactions::CheckTransactionStatusPassivate(), poolactions::FreeConnectionDestroy())
 {}
 
+const poolactions::QueryValidate& PostgrePool::validator()
+{
+  return validateAction;
+}
+
 bool PostgreConnectionParams::operator ==(const PostgreConnectionParams &other)
 {
     return
@@ -18,11 +18,17 @@ struct PostgreConnectionParams {
   bool operator == (const PostgreConnectionParams& other);
 };
 
-/** specification of a generic pool with postgre factory validator and passivate action*/
+/** specification of a generic pool with postgre factory validator and passivate action
+  * if `probe` is set connections are validated by probing its sockets and validation query
+  * is executed only if probe could not decide (see `poolactions::QueryValidate`)
+  */
 class PostgrePool: public Pool<poolactions::PostgreCreate, poolactions::QueryValidate, poolactions::StubActivate, poolactions::CheckTransactionStatusPassivate, poolactions::FreeConnectionDestroy>
 {
 public:
-  PostgrePool(PostgreConnectionParams connectionParams, PoolParams params);
+  PostgrePool(PostgreConnectionParams connectionParams, PoolParams params, bool probe = false);
+
+  /** validation action of the pool, e.g. to read its counters */
+  const poolactions::QueryValidate& validator();
 };
 
 
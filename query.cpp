@@ -3,15 +3,27 @@
 namespace nkdhny{
 namespace db{
 
-Query::Query(PGconn *_connection, const std::string &_query):
+Query::Query(PGconn *_connection, const std::string &_query, int _promote_after):
     connection(_connection),
-    query(_query)
+    query(_query),
+    promote_after(_promote_after)
 {}
 
 Result Query::operator ()()
 {
+    const PreparedStatement* statement = NULL;
 
-    PGresult* result = PQexecParams(connection, query.c_str(), parameters.count(), NULL, parameters.values().data(), parameters.sizes().data(), parameters.formats().data(), /*binary*/ 1);
+    if(promote_after > 0) {
+        statement = StatementCache::find(connection, query, parameters);
+
+        if(statement == NULL && StatementCache::executed(connection, query) >= promote_after) {
+            statement = StatementCache::prepare(connection, query, parameters);
+        }
+    }
+
+    PGresult* result = statement == NULL ?
+        PQexecParams(connection, query.c_str(), parameters.count(), parameters.types(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1) :
+        PQexecPrepared(connection, statement->name.c_str(), parameters.count(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
     parameters.clear();
 #ifdef DEBUG
     int query_status = PQresultStatus(result);
@@ -22,6 +34,23 @@ Result Query::operator ()()
     return r;
 }
 
+Future Query::sendAsync(EventLoop &loop, AsyncCallback *callback)
+{
+    const PreparedStatement* statement = promote_after > 0 ? StatementCache::find(connection, query, parameters) : NULL;
+
+    PQsetnonblocking(connection, 1);
+
+    //query which failed to be sent is completed by the loop at once with no result
+    if(statement == NULL) {
+        PQsendQueryParams(connection, query.c_str(), parameters.count(), parameters.types(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
+    } else {
+        PQsendQueryPrepared(connection, statement->name.c_str(), parameters.count(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
+    }
+    parameters.clear();
+
+    return loop.watch(connection, callback);
+}
+
 
 
 }
@@ -7,6 +7,8 @@
 #include "assert.h"
 #include "parambuilder.h"
 #include "result.h"
+#include "statementcache.h"
+#include "eventloop.h"
 #include <stdlib.h>
 #include <time.h>
 #include <sstream>
@@ -21,6 +23,7 @@ private:
     std::string query;
     PGconn* connection;
     ParamBuilder parameters;
+    int promote_after;
 
     Query(const Query&);
     const Query& operator =(const Query&);
@@ -30,8 +33,10 @@ public:
       * provide parameters to this query and execute it. No comunication
       * to DB is done prior to query execution.
       * Query will be compiled each time it executed, thus for repeated
-      * queries consider `nkdhny::QueryTemplate`*/
-    Query(PGconn* _connection, const std::string& _query);
+      * queries consider `nkdhny::QueryTemplate`, or set `_promote_after`:
+      * query executed this count of times on the connection is prepared (see `StatementCache`)
+      * and executed as a prepared statement since then, 0 (by default) means never */
+    Query(PGconn* _connection, const std::string& _query, int _promote_after = 0);
 
     /** @brief bind parameter of type `T` with value `value`
       * to a subsequent query parameter. See `ParamBuilder` on
@@ -47,6 +52,11 @@ public:
       */
     Result operator()();
 
+    /** sends query without waiting for its result and clears its parameter list,
+      * the result is read by `loop` (see `EventLoop`), `callback` if given is called then.
+      * The connection is not to be used until the query is done */
+    Future sendAsync(EventLoop& loop, AsyncCallback* callback = NULL);
+
 };
 
 template <typename T>
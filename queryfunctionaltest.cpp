@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 #include "connection.h"
 #include "row.h"
+#include "statementcache.h"
 
 using namespace nkdhny::db;
 
@@ -59,6 +60,126 @@ TEST(QueryTemplateTest, MustPerformDDLAndCRUD) {
     drop();
 }
 
+TEST(QueryTemplateTest, MustPromoteFrequentQueryToPreparedStatement) {
+
+    Connection<> c(getConnection());
+
+    for(int i = 0; i < 3; i++) {
+        Query select(c, "select $1::bigint as _long", 2);
+        select.pushParameter(static_cast<long>(i));
+        Result result = select();
+
+        EXPECT_EQ(result.begin().get<long>("_long"), i);
+        EXPECT_EQ(StatementCache::count(c), i < 1 ? 0 : 1);
+    }
+}
+
+TEST(QueryTemplateTest, MustBindPromotedQueryAsNotPrepared) {
+
+    Connection<> c(getConnection());
+    Query create(c, "create table t(id bigint);");
+    create();
+    Query insert(c, "insert into t values (1);");
+    insert();
+
+    //server would take $1 for bigint, int is bound as int4 either way
+    for(int i = 0; i < 3; i++) {
+        Query select(c, "select count(*)::int as _int from t where id = $1", 1);
+        Result result = select.pushParameter(1)();
+
+        EXPECT_EQ(result.begin().get<int>("_int"), 1);
+        EXPECT_EQ(StatementCache::count(c), 1);
+    }
+
+    Query drop(c, "drop table t;");
+    drop();
+}
+
+TEST(QueryTemplateTest, MustBindAndReadArrays) {
+    Connection<> c(getConnection());
+
+    std::vector<int> ids;
+    for(int i = 0; i < 5000; i++) {
+        ids.push_back(i);
+    }
+
+    Query count(c, "select count(*)::int as _int from generate_series(0, 9999) as i where i = ANY($1)");
+    EXPECT_EQ(count.pushParameter(ids)().begin().get<int>("_int"), 5000);
+
+    std::vector<std::string> names;
+    names.push_back("foo");
+    names.push_back("");
+    names.push_back("bar");
+
+    Query echo(c, "select $1::text[] as _texts, $2::bigint[] as _longs, $3::int[] as _ints");
+    Result r = echo.pushParameter(names).pushParameter(std::vector<long>(2, 1L << 40)).pushParameter(std::vector<int>())();
+    Row row = r.begin();
+
+    EXPECT_EQ(row.get< std::vector<std::string> >("_texts"), names);
+    EXPECT_EQ(row.get< std::vector<long> >("_longs"), std::vector<long>(2, 1L << 40));
+    EXPECT_TRUE(row.get< std::vector<int> >("_ints").empty());
+}
+
+TEST(QueryTemplateTest, MustResolveColumnNamesAsLibpq) {
+    Connection<> c(getConnection());
+
+    Query q(c, "select 1::int as lower, 2::int as \"Mixed\", 3::int as \"with \"\"quote\"\"\", 4::int as lower, 5::int as \"\"");
+    Result r = q();
+
+    const char* names[] = {"lower", "LOWER", "Mixed", "\"Mixed\"", "\"mixed\"", "\"with \"\"quote\"\"\"", "\"\"", "", "missing", "Lo\"wer\""};
+    for(size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+        EXPECT_EQ(r.colno(names[i]), PQfnumber(r.begin().res, names[i])) << names[i];
+    }
+
+    int mixed = r.colno("\"Mixed\"");
+    for(Row row = r.begin(); row != r.end(); ++row) {
+        EXPECT_EQ(row.get<int>("LOWER"), 1);
+        EXPECT_EQ(row.get<int>(mixed), 2);
+    }
+}
+
+TEST(QueryTemplateTest, MustExtractWholeColumns) {
+    Connection<> c(getConnection());
+
+    Query q(c, "select i::int as _int, i::bigint << 32 as _long, i::float8 / 2 as _double,"
+               " nullif(i % 3, 0)::int as _nullable from generate_series(0, 999) as i");
+    Result r = q();
+
+    std::vector<int> ints = r.column<int>("_int");
+    std::vector<long> longs = r.column<long>(1);
+    std::vector<double> doubles = r.column<double>("_double");
+    std::vector<bool> nulls;
+    std::vector<int> nullable = r.column<int>("_nullable", &nulls);
+
+    ASSERT_EQ(ints.size(), 1000u);
+    ASSERT_EQ(nulls.size(), 1000u);
+    for(int i = 0; i < 1000; i++) {
+        EXPECT_EQ(ints[i], i);
+        EXPECT_EQ(longs[i], static_cast<long>(i) << 32);
+        EXPECT_EQ(doubles[i], i / 2.0);
+        EXPECT_EQ(nulls[i], i % 3 == 0);
+        EXPECT_EQ(nullable[i], i % 3);
+    }
+}
+
+TEST(QueryTemplateTest, MustGetTextAndByteaWithoutCopy) {
+    Connection<> c(getConnection());
+
+    Query q(c, "select 'text'::text as _text, '\\x00ff0061'::bytea as _bytea, ''::text as _empty");
+    Result r = q();
+    Row row = r.begin();
+
+    Span text = row.get<Span>("_text");
+    EXPECT_EQ(text, std::string("text"));
+    EXPECT_EQ(text.data, PQgetvalue(row.res, 0, 0));
+
+    const char bytes[] = {0, static_cast<char>(0xff), 0, 'a'};
+    EXPECT_EQ(row.get<Span>("_bytea"), Span(bytes, sizeof(bytes)));
+    EXPECT_EQ(row.get<std::string>("_bytea"), std::string(bytes, sizeof(bytes)));
+
+    EXPECT_TRUE(row.get<Span>("_empty").empty());
+}
+
 int main(int argc, char **argv) {
 
   srand (time(NULL));
@@ -1,82 +1,72 @@
 #include "querytemplate.h"
 
-
 namespace nkdhny {
 namespace db {
 
 
-static std::string guesNameForQuery(const std::string& query) {
-    std::stringstream ss;
-    ss<<rand();
-
-    return ss.str();
-}
-
-struct ParameterCounter {
-    int* result;
-    void operator()(const char symbol) {
-        if(symbol == '1') {
-            ++(*result);
-        }
-    }
-};
-
-static int countParameters(const std::string& query) {
-
-    int result;
-    ParameterCounter counter;
-
-    counter.result = &result;
-
-    std::for_each(query.begin(), query.end(), counter);
-
-    return result;
-}
-
-
 QueryTemplate::QueryTemplate(PGconn *_connection, const std::string& query, const std::string _name):
-    parameters(),
+    sql(query),
+    named(_name),
+    described(false),
     connection(_connection),
-    name(_name)
+    parameters()
 {
-    if(name.empty()){
-        name = guesNameForQuery(query);
+    //statement which could not be prepared is reported by the server when the query is executed
+    if(named.name.empty()){
+        StatementCache::prepare(connection, sql);
+        return;
     }
 
-    if(!checkIfAlreadyExists()) {
+    described = checkIfAlreadyExists() ? named.describe(connection) : named.prepare(connection, sql);
+}
 
-        PGresult* prepared_result = PQprepare(connection, name.c_str(), query.c_str(), countParameters(query), NULL);
-        assert(PQresultStatus(prepared_result) == PGRES_COMMAND_OK);
-        PQclear(prepared_result);
+const PreparedStatement* QueryTemplate::statement()
+{
+    //cached statement could be evicted by other templates, then it is prepared again
+    if(named.name.empty()) {
+        return StatementCache::prepare(connection, sql);
     }
 
+    return described ? &named : NULL;
 }
 
 Result QueryTemplate::operator ()()
 {
+    const PreparedStatement* prepared = statement();
+    assert(prepared == NULL || prepared->accepts(parameters));
 
-    assert(checkParametersAreConsistentToQuery());
-    PGresult* result = PQexecPrepared(connection, name.c_str(), parameters.count(), parameters.values().data(), parameters.sizes().data(), parameters.formats().data(), /*binary*/ 1);
+    PGresult* result = prepared == NULL ?
+        PQexecParams(connection, sql.c_str(), parameters.count(), parameters.types(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1) :
+        PQexecPrepared(connection, prepared->name.c_str(), parameters.count(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
     parameters.clear();
     Result r = Result(result);
 
     return r;
 }
 
-bool QueryTemplate::checkParametersAreConsistentToQuery()
+Future QueryTemplate::sendAsync(EventLoop &loop, AsyncCallback *callback)
 {
-    PGresult* result = PQdescribePrepared(connection, name.c_str());
-    assert(PQresultStatus(result) == PGRES_COMMAND_OK);
-    bool r = (parameters.count() == PQnparams(result));
-    PQclear(result);
-    return r;
+    //statement is prepared synchronously, before the connection is given to the loop
+    const PreparedStatement* prepared = statement();
+    assert(prepared == NULL || prepared->accepts(parameters));
+
+    PQsetnonblocking(connection, 1);
+    //query which failed to be sent is completed by the loop at once with no result
+    if(prepared == NULL) {
+        PQsendQueryParams(connection, sql.c_str(), parameters.count(), parameters.types(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
+    } else {
+        PQsendQueryPrepared(connection, prepared->name.c_str(), parameters.count(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
+    }
+    parameters.clear();
+
+    return loop.watch(connection, callback);
 }
 
 bool QueryTemplate::checkIfAlreadyExists()
 {
 
     Query check_statement_exists(connection,"select * from pg_prepared_statements where name like $1");
-    check_statement_exists.pushParameter(name);
+    check_statement_exists.pushParameter(named.name);
     Result result = check_statement_exists();
     int statementsCount = result.count();
     assert(statementsCount<2 && statementsCount>=0);
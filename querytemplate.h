@@ -8,6 +8,7 @@
 #include "parambuilder.h"
 #include "result.h"
 #include "query.h"
+#include "statementcache.h"
 #include <stdlib.h>
 #include <time.h>
 #include <sstream>
@@ -19,25 +20,32 @@ namespace db {
   * it compiles query (see constructor)
   * than one could bind parameters to a compiled query (see `pushParameter` method)
   * after parameters are bound one could execute query (see `operator ()`)
+  * Unless the name is given explicitly statement is prepared once per connection and
+  * is shared by all templates of the same query (see `StatementCache`)
   */
 class QueryTemplate
 {
 private:
-    std::string name;
+    std::string sql;
+    /** statement named explicitly, its name is empty if statement is cached */
+    PreparedStatement named;
+    /** false if the statement named explicitly could not be prepared or described */
+    bool described;
     PGconn* connection;
     ParamBuilder parameters;
 
     QueryTemplate(const QueryTemplate&);
     const QueryTemplate& operator =(const QueryTemplate&);
 
-    bool checkParametersAreConsistentToQuery();
     bool checkIfAlreadyExists();
+    /** statement to execute the query by, `NULL` if it could not be prepared */
+    const PreparedStatement* statement();
 
 public:
     /** @brief compiles given `query` in the context of
       * `_connection` and stores it in DB with name `_name`
-      * if no name is given explicitly it will be (randomly)
-      * guessed*/
+      * if no name is given explicitly the statement is taken from
+      * (or prepared and put to) the statement cache of the connection */
     QueryTemplate(PGconn* _connection, const std::string& query, const std::string _name="");
 
     /** @brief bind parameter of type `T` with value `value`
@@ -48,10 +56,15 @@ public:
 
     /** executes query and clears its parameter list
       * One could bund new parameters to this query and execute it
-      * onece more
+      * onece more. Parameters are checked against the statement description
+      * taken when it was prepared, thus execution is a single round trip.
+      * If the statement could not be prepared the query is executed as is, thus error of the server is returned
       */
     Result operator()();
 
+    /** sends query without waiting for its result and clears its parameter list (see `Query::sendAsync`) */
+    Future sendAsync(EventLoop& loop, AsyncCallback* callback = NULL);
+
 
 };
 
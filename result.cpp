@@ -1,5 +1,7 @@
 #include "result.h"
+#include "byteswap.h"
 #include <utility>
+#include <string.h>
 
 namespace nkdhny {
 namespace db {
@@ -7,28 +9,41 @@ namespace db {
 
 Result::Result(const Result &other):
     owner(true),
-    result(other.result)
+    result(other.result),
+    columns(other.columns)
 {
     assert(other.owner);
     assert(other.result!=NULL);
 
     const_cast<Result&>(other).owner = false;
     const_cast<Result&>(other).result = NULL;
+    const_cast<Result&>(other).columns = NULL;
 }
 
 Result::Result(PGresult *_result):
     owner(true),
-    result(_result)
+    result(_result),
+    columns(NULL)
 {
     assert(_result!=NULL);
 }
 
+Result::Result():
+    result(NULL),
+    owner(false),
+    columns(NULL)
+{
+}
+
 Result::~Result()
 {
     if(isDefined()) {
         PQclear(result);
     }
     result = NULL;
+
+    delete columns;
+    columns = NULL;
 }
 
 const Result& Result::operator=(Result& other) {
@@ -36,18 +51,27 @@ const Result& Result::operator=(Result& other) {
 
     std::swap(owner, other.owner);
     std::swap(result, other.result);
+    std::swap(columns, other.columns);
 
     return *this;
 }
 
+ColumnIndex* Result::index()
+{
+    if(columns == NULL) {
+        columns = new ColumnIndex();
+    }
+    return columns;
+}
+
 Row Result::begin()
 {
-    return Row(result, 0);
+    return Row(result, 0, index());
 }
 
 Row Result::end()
 {
-    return Row(result, PQntuples(result));
+    return Row(result, PQntuples(result), index());
 }
 
 int Result::count()
@@ -56,6 +80,93 @@ int Result::count()
     return PQntuples(result);
 }
 
+int Result::colno(const std::string &colname)
+{
+    assert(isDefined());
+    return index()->find(result, colname);
+}
+
+/** copies binary representations of `colno` column values of each row one after another to `raw`,
+  * null values are zero */
+template <typename Word>
+static void gather(PGresult* result, int colno, Word* raw, std::vector<bool>* nulls) {
+    int count = PQntuples(result);
+
+    if(nulls != NULL) {
+        nulls->assign(count, false);
+    }
+
+    for(int i = 0; i < count; i++) {
+        if(PQgetisnull(result, i, colno)) {
+            raw[i] = 0;
+            if(nulls != NULL) {
+                (*nulls)[i] = true;
+            }
+            continue;
+        }
+
+#ifdef DEBUG
+        assert(PQgetlength(result, i, colno) == sizeof(Word));
+#endif
+        memcpy(raw + i, PQgetvalue(result, i, colno), sizeof(Word));
+    }
+}
+
+template <>
+std::vector<int> Result::column<int>(int colno, std::vector<bool>* nulls) {
+    assert(isDefined());
+    assert(colno >= 0 && colno < PQnfields(result));
+
+    std::vector<int> values(PQntuples(result));
+    if(!values.empty()) {
+        uint32_t* raw = reinterpret_cast<uint32_t*>(&values[0]);
+        gather(result, colno, raw, nulls);
+        networkToHost32(raw, values.size());
+    } else if(nulls != NULL) {
+        nulls->clear();
+    }
+
+    return values;
+}
+
+template <>
+std::vector<long> Result::column<long>(int colno, std::vector<bool>* nulls) {
+    assert(isDefined());
+    assert(colno >= 0 && colno < PQnfields(result));
+#ifdef DEBUG
+    assert(sizeof(long) == sizeof(uint64_t));
+#endif
+
+    std::vector<long> values(PQntuples(result));
+    if(!values.empty()) {
+        uint64_t* raw = reinterpret_cast<uint64_t*>(&values[0]);
+        gather(result, colno, raw, nulls);
+        networkToHost64(raw, values.size());
+    } else if(nulls != NULL) {
+        nulls->clear();
+    }
+
+    return values;
+}
+
+template <>
+std::vector<double> Result::column<double>(int colno, std::vector<bool>* nulls) {
+    assert(isDefined());
+    assert(colno >= 0 && colno < PQnfields(result));
+
+    std::vector<uint64_t> raw(PQntuples(result));
+    std::vector<double> values(raw.size());
+    if(!raw.empty()) {
+        gather(result, colno, &raw[0], nulls);
+        networkToHost64(&raw[0], raw.size());
+        memcpy(&values[0], &raw[0], raw.size()*sizeof(double));
+    } else if(nulls != NULL) {
+        nulls->clear();
+    }
+
+    return values;
+}
+
 bool Result::isDefined()
 {
     if(owner){
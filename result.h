@@ -3,6 +3,8 @@
 
 
 #include "row.h"
+#include "rowbinder.h"
+#include <vector>
 #include <assert.h>
 
 namespace nkdhny {
@@ -21,6 +23,11 @@ private:
       * owner will release inner result in process of destruction
       * like with auto_ptr ownership is transfered when object is copied **/
     bool owner;
+    /** column numbers by name, built on the first named access
+      * and shared by my rows, it is transfered along with the result */
+    ColumnIndex* columns;
+
+    ColumnIndex* index();
 public:
     Result(const Result& other);
     Result(PGresult* _result);
@@ -39,11 +46,50 @@ public:
 
     int count();
 
+    /** number of column `colname` as `Row::get` resolves it, -1 if there is no such column,
+      * thus the name could be resolved once for all rows */
+    int colno(const std::string& colname);
+
+    /** values of column `colno` of all rows in a contiguous array, null values are `0`,
+      * `nulls` if given is set to flags of null values. Column of `int4`, `int8` or `float8`
+      * is got as `int`, `long` or `double`, values are decoded in bulk (see `networkToHost32`)
+      */
+    template <typename _T>
+    std::vector<_T> column(int colno, std::vector<bool>* nulls = NULL);
+
+    /** values of named column of all rows (see `column(int)`) */
+    template <typename _T>
+    std::vector<_T> column(const std::string& colname, std::vector<bool>* nulls = NULL);
+
+    /** rows read as objects of `T` described by `RowTraits<T>` (see `RowBinder`),
+      * columns are resolved and their types are checked once here, range is empty if they do not match
+      * @verbatim
+      *     RowRange<Foo> foos = result.as<Foo>();
+      *     assert(foos.bound());
+      *     for(RowRange<Foo>::iterator i = foos.begin(); i != foos.end(); ++i) {
+      *         Foo foo = *i;
+      *     }
+      * @endverbatim
+      */
+    template <typename T>
+    RowRange<T> as();
+
     /** returns true if thes wrapper owns its inner PGResult */
     bool isDefined();
 
  };
 
+template <typename T>
+std::vector<T> Result::column(const std::string& colname, std::vector<bool>* nulls) {
+    return column<T>(colno(colname), nulls);
+}
+
+template <typename T>
+RowRange<T> Result::as() {
+    assert(isDefined());
+    return RowRange<T>(result, index());
+}
+
 }
 }
 
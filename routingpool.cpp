@@ -0,0 +1,210 @@
+#include "routingpool.h"
+#include "atomic.h"
+#include "time.h"
+
+namespace nkdhny {
+namespace db {
+
+RoutingParams::RoutingParams():
+  balance(LEAST_OUTSTANDING),
+  ejection_time(5000),
+  read_from_primary(true),
+  probe(false)
+{}
+
+RoutingPool::Endpoint::Endpoint(const PostgreConnectionParams &_params):
+  params(_params),
+  pool(NULL),
+  ejected_until(0),
+  ejections(0),
+  latency(0),
+  failures(0)
+{}
+
+RoutingPool::RoutingPool(PostgreConnectionParams primary, const std::vector<PostgreConnectionParams> &replicas, PoolParams _params, RoutingParams _routing):
+  params(_params),
+  routing(_routing),
+  endpoints(),
+  rotation(0),
+  lock()
+{
+  endpoints.push_back(new Endpoint(primary));
+  for(size_t i = 0; i < replicas.size(); i++) {
+    endpoints.push_back(new Endpoint(replicas[i]));
+  }
+
+  for(size_t i = 0; i < endpoints.size(); i++) {
+    try {
+      open(*endpoints[i]);
+    } catch(PoolCouldNotCreateValidConnection&) {
+      eject(*endpoints[i]);
+    }
+  }
+}
+
+RoutingPool::~RoutingPool()
+{
+  for(size_t i = 0; i < endpoints.size(); i++) {
+    delete endpoints[i]->pool;
+    delete endpoints[i];
+  }
+}
+
+RoutingPool::PooledConnection RoutingPool::borrowWrite() throw (PoolIsEmpty, PoolCouldNotCreateValidConnection)
+{
+  Endpoint& primary = *endpoints[0];
+
+  if(ejected(primary)) {
+    throw PoolCouldNotCreateValidConnection();
+  }
+
+  try {
+    return borrowFrom(primary);
+  } catch(PoolCouldNotCreateValidConnection&) {
+    eject(primary);
+    throw;
+  }
+}
+
+RoutingPool::PooledConnection RoutingPool::borrowRead() throw (PoolIsEmpty, PoolCouldNotCreateValidConnection)
+{
+  //each failed replica is ejected, thus it is not picked again unless ejection time is 0
+  for(size_t attempt = 1; attempt < endpoints.size(); attempt++) {
+    int index = pick();
+    if(index < 0) {
+      break;
+    }
+
+    try {
+      return borrowFrom(*endpoints[index]);
+    } catch(PoolCouldNotCreateValidConnection&) {
+      eject(*endpoints[index]);
+    }
+  }
+
+  if(routing.read_from_primary) {
+    return borrowWrite();
+  }
+
+  throw PoolCouldNotCreateValidConnection();
+}
+
+int RoutingPool::countEndpoints()
+{
+  return endpoints.size();
+}
+
+bool RoutingPool::ejected(int endpoint)
+{
+  return ejected(*endpoints[endpoint]);
+}
+
+long RoutingPool::countEjections(int endpoint)
+{
+  return atomicGet(endpoints[endpoint]->ejections);
+}
+
+int RoutingPool::countInUse(int endpoint)
+{
+  PostgrePool* pool = atomicGet(endpoints[endpoint]->pool);
+  return pool == NULL ? 0 : pool->countInUse();
+}
+
+PoolStats RoutingPool::stats(int endpoint)
+{
+  PostgrePool* pool = atomicGet(endpoints[endpoint]->pool);
+  return pool == NULL ? PoolStats() : pool->stats();
+}
+
+PostgrePool* RoutingPool::open(Endpoint &e) throw (PoolCouldNotCreateValidConnection)
+{
+  PostgrePool* pool = atomicGet(e.pool);
+  if(pool != NULL) {
+    return pool;
+  }
+
+  volatile Lock _lock(lock);
+
+  if(e.pool == NULL) {
+    PostgrePool* created = new PostgrePool(e.params, params, routing.probe);
+    //full barrier, the pool is published after it is constructed
+    atomicCompareAndSet(e.pool, static_cast<PostgrePool*>(NULL), created);
+  }
+
+  return e.pool;
+}
+
+RoutingPool::PooledConnection RoutingPool::borrowFrom(Endpoint &e) throw (PoolIsEmpty, PoolCouldNotCreateValidConnection)
+{
+  PostgrePool* pool = open(e);
+
+  try {
+    long started = gettime_us();
+    PooledConnection c = pool->borrow();
+    long sample = gettime_us() - started;
+
+    long average = e.latency;
+    e.latency = average + (sample - average)/8;
+    e.failures = pool->countFailures();
+
+    return c;
+  } catch(PoolIsEmpty&) {
+    //pool with maintainer is found empty while the maintainer fails to replace its connections
+    if(pool->countFailures() > atomicGet(e.failures)) {
+      throw PoolCouldNotCreateValidConnection();
+    }
+    throw;
+  }
+}
+
+bool RoutingPool::ejected(Endpoint &e)
+{
+  return gettime_ms() < atomicGet(e.ejected_until);
+}
+
+void RoutingPool::eject(Endpoint &e)
+{
+  e.ejected_until = gettime_ms() + routing.ejection_time;
+  atomicAdd(e.ejections, 1L);
+}
+
+long RoutingPool::load(Endpoint &e)
+{
+  if(routing.balance == RoutingParams::LEAST_LATENCY) {
+    return e.latency;
+  }
+
+  PostgrePool* pool = atomicGet(e.pool);
+  return pool == NULL ? 0 : pool->countInUse();
+}
+
+int RoutingPool::pick()
+{
+  unsigned replicas = endpoints.size() - 1;
+  if(replicas == 0) {
+    return -1;
+  }
+
+  unsigned start = static_cast<unsigned>(atomicAdd(rotation, 1));
+
+  int best = -1;
+  long best_load = 0;
+
+  for(unsigned i = 0; i < replicas; i++) {
+    int index = 1 + (start + i) % replicas;
+    if(ejected(*endpoints[index])) {
+      continue;
+    }
+
+    long l = load(*endpoints[index]);
+    if(best < 0 || l < best_load) {
+      best = index;
+      best_load = l;
+    }
+  }
+
+  return best;
+}
+
+}
+}
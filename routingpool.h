@@ -0,0 +1,108 @@
+#ifndef ROUTINGPOOL_H
+#define ROUTINGPOOL_H
+
+#include <vector>
+#include "postgrepool.h"
+#include "lock.h"
+
+namespace nkdhny {
+namespace db {
+
+struct RoutingParams {
+  enum Balance {
+    /** read is routed to the replica with the least count of borrowed connections */
+    LEAST_OUTSTANDING,
+    /** read is routed to the replica with the least average time to borrow a connection */
+    LEAST_LATENCY
+  };
+
+  /** how reads are balanced between replicas, `LEAST_OUTSTANDING` by default */
+  Balance balance;
+  /** endpoint failed to give a valid connection is not used for this count of ms, 5000 by default */
+  long ejection_time;
+  /** if set reads are routed to the primary when every replica is ejected, set by default */
+  bool read_from_primary;
+  /** if set connections are validated by probing its sockets (see `PostgrePool`), unset by default */
+  bool probe;
+
+  RoutingParams();
+};
+
+/** Pool of connections to a primary server and its replicas
+  * Each endpoint has its own `PostgrePool` created with the same `PoolParams`,
+  * writes are borrowed from the primary, reads are balanced between replicas (see `RoutingParams::balance`),
+  * ties are broken in round robin order
+  *
+  * Endpoint which pool throws `PoolCouldNotCreateValidConnection`, i.e. the server could not be connected to
+  * or connections to it are not valid, is ejected for `ejection_time` ms. Borrowing from ejected endpoint
+  * fails at once, borrowing a read is retried with the next replica. After ejection is over
+  * the endpoint is tried again. Endpoint which pool could not be heated while constructing is ejected too
+  * and its pool is created when the endpoint is tried again
+  *
+  * `PoolIsEmpty` is not a failure of the endpoint and is thrown to a client as is, unless connections of the endpoint
+  * failed since a connection was borrowed from it last time (see `Pool::countFailures`). With `maintenance_interval` set
+  * connections which could not be created or are not valid are replaced by the maintainer, thus an unhealthy endpoint
+  * is found empty rather than failed, it is ejected then as well
+  *
+  * Borrowing is thread safe, the routing pool lock is held only to create pools of endpoints
+  */
+class RoutingPool
+{
+public:
+  typedef PostgrePool::PooledConnection PooledConnection;
+
+  RoutingPool(PostgreConnectionParams primary, const std::vector<PostgreConnectionParams>& replicas, PoolParams params, RoutingParams routing = RoutingParams());
+  ~RoutingPool();
+
+  /** connection to the primary */
+  PooledConnection borrowWrite() throw (PoolIsEmpty, PoolCouldNotCreateValidConnection);
+  /** connection to a replica, or to the primary if there is no replica available and `read_from_primary` is set */
+  PooledConnection borrowRead() throw (PoolIsEmpty, PoolCouldNotCreateValidConnection);
+
+  /** count of endpoints, the primary is endpoint 0 and replicas follow in order they were given */
+  int countEndpoints();
+  bool ejected(int endpoint);
+  /** count of times the endpoint was ejected */
+  long countEjections(int endpoint);
+  /** count of connections borrowed from the endpoint and not yet returned */
+  int countInUse(int endpoint);
+  /** statistics of the endpoint pool, empty if the pool is not created yet */
+  PoolStats stats(int endpoint);
+
+private:
+  struct Endpoint {
+    PostgreConnectionParams params;
+    /** created once and never changed until the routing pool is destroyed */
+    PostgrePool* volatile pool;
+    volatile long ejected_until;
+    volatile long ejections;
+    /** moving average of time in us to borrow a connection, updated without locking as a lost sample does not matter */
+    volatile long latency;
+    /** count of failures of the endpoint pool when a connection was borrowed from it last time */
+    volatile long failures;
+
+    explicit Endpoint(const PostgreConnectionParams& _params);
+  };
+
+  PoolParams params;
+  RoutingParams routing;
+  std::vector<Endpoint*> endpoints;
+  volatile int rotation;
+  Mutex lock;
+
+  PostgrePool* open(Endpoint& e) throw (PoolCouldNotCreateValidConnection);
+  PooledConnection borrowFrom(Endpoint& e) throw (PoolIsEmpty, PoolCouldNotCreateValidConnection);
+  bool ejected(Endpoint& e);
+  void eject(Endpoint& e);
+  long load(Endpoint& e);
+  /** index of the least loaded replica which is not ejected, or -1 if there is no one */
+  int pick();
+
+  RoutingPool(const RoutingPool&);
+  const RoutingPool& operator=(const RoutingPool&);
+};
+
+}
+}
+
+#endif // ROUTINGPOOL_H
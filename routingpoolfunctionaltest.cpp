@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "routingpool.h"
+#include <string>
+#include <vector>
+
+static nkdhny::db::PostgreConnectionParams endpoint(int port) {
+  nkdhny::db::PostgreConnectionParams params;
+  params.host = "127.0.0.1";
+  params.database = "richquery";
+  params.role = "credentials";
+  params.password = "credentials";
+  params.port = port;
+  return params;
+}
+
+static const int port = 5432;
+static const int dead_port = 1;
+
+TEST(RoutingPool, shouldBalanceReadsBetweenReplicas) {
+  std::vector<nkdhny::db::PostgreConnectionParams> replicas;
+  replicas.push_back(endpoint(port));
+  replicas.push_back(endpoint(port));
+
+  nkdhny::db::RoutingPool pool(endpoint(port), replicas, nkdhny::db::PoolParams(4, 1, 2, 1, 100));
+
+  EXPECT_EQ(3, pool.countEndpoints());
+
+  {
+    nkdhny::db::RoutingPool::PooledConnection first = pool.borrowRead();
+    nkdhny::db::RoutingPool::PooledConnection second = pool.borrowRead();
+
+    EXPECT_EQ(0, pool.countInUse(0));
+    EXPECT_EQ(1, pool.countInUse(1));
+    EXPECT_EQ(1, pool.countInUse(2));
+
+    nkdhny::db::RoutingPool::PooledConnection write = pool.borrowWrite();
+    EXPECT_EQ(1, pool.countInUse(0));
+  }
+
+  EXPECT_EQ(0, pool.countInUse(1));
+  EXPECT_EQ(0, pool.countInUse(2));
+}
+
+TEST(RoutingPool, shouldEjectUnavailableReplica) {
+  std::vector<nkdhny::db::PostgreConnectionParams> replicas;
+  replicas.push_back(endpoint(dead_port));
+  replicas.push_back(endpoint(port));
+
+  nkdhny::db::RoutingPool pool(endpoint(port), replicas, nkdhny::db::PoolParams(4, 1, 2, 1, 100));
+
+  EXPECT_FALSE(pool.ejected(0));
+  EXPECT_TRUE(pool.ejected(1));
+  EXPECT_FALSE(pool.ejected(2));
+
+  for(int i = 0; i < 4; i++) {
+    nkdhny::db::RoutingPool::PooledConnection c = pool.borrowRead();
+    EXPECT_EQ(CONNECTION_OK, PQstatus(c));
+    EXPECT_EQ(1, pool.countInUse(2));
+  }
+
+  EXPECT_EQ(1, pool.countEjections(1));
+}
+
+TEST(RoutingPool, shouldReadFromPrimaryWhenEveryReplicaIsEjected) {
+  std::vector<nkdhny::db::PostgreConnectionParams> replicas;
+  replicas.push_back(endpoint(dead_port));
+
+  nkdhny::db::RoutingParams routing;
+
+  {
+    nkdhny::db::RoutingPool pool(endpoint(port), replicas, nkdhny::db::PoolParams(4, 1, 2, 1, 100), routing);
+
+    nkdhny::db::RoutingPool::PooledConnection c = pool.borrowRead();
+    EXPECT_EQ(1, pool.countInUse(0));
+  }
+
+  routing.read_from_primary = false;
+
+  {
+    nkdhny::db::RoutingPool pool(endpoint(port), replicas, nkdhny::db::PoolParams(4, 1, 2, 1, 100), routing);
+
+    EXPECT_THROW(pool.borrowRead(), nkdhny::db::PoolCouldNotCreateValidConnection);
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,12 +1,15 @@
 #include "row.h"
+#include <endian.h>
+#include <string.h>
 
 namespace nkdhny{
 namespace db{
 
 
-Row::Row(PGresult *_result, int _rowno):
+Row::Row(PGresult *_result, int _rowno, ColumnIndex *_columns):
     res(_result),
-    rowno(_rowno)
+    rowno(_rowno),
+    columns(_columns)
 {}
 
 bool Row::operator ==(const Row &other) const
@@ -36,7 +39,14 @@ template <>
 std::string Row::get<std::string> (int colno) {
     assert(rowno < PQntuples(res));
     assert(colno < PQnfields(res));
-    return std::string(PQgetvalue(res, rowno, colno));
+    return std::string(PQgetvalue(res, rowno, colno), PQgetlength(res, rowno, colno));
+}
+
+template <>
+Span Row::get<Span> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+    return Span(PQgetvalue(res, rowno, colno), PQgetlength(res, rowno, colno));
 }
 
 
@@ -114,5 +124,191 @@ unsigned long long Row::get<unsigned long long> (int colno) {
     return static_cast<unsigned long long>(this->get<long long>(colno));
 }
 
+template <>
+float Row::get<float> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+#ifdef DEBUG
+    assert(PQgetlength(res, rowno, colno) == sizeof(float));
+#endif
+    uint32_t binary;
+    memcpy(&binary, PQgetvalue(res, rowno, colno), sizeof(binary));
+    binary = be32toh(binary);
+
+    float value;
+    memcpy(&value, &binary, sizeof(value));
+    return value;
+}
+
+template <>
+double Row::get<double> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+#ifdef DEBUG
+    assert(PQgetlength(res, rowno, colno) == sizeof(double));
+#endif
+    uint64_t binary;
+    memcpy(&binary, PQgetvalue(res, rowno, colno), sizeof(binary));
+    binary = be64toh(binary);
+
+    double value;
+    memcpy(&value, &binary, sizeof(value));
+    return value;
+}
+
+template <>
+bool Row::get<bool> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+    return PQgetlength(res, rowno, colno) == 1 && *PQgetvalue(res, rowno, colno) != 0;
+}
+
+template <>
+Timestamp Row::get<Timestamp> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+#ifdef DEBUG
+    assert(PQgetlength(res, rowno, colno) == sizeof(uint64_t));
+#endif
+    uint64_t binary;
+    memcpy(&binary, PQgetvalue(res, rowno, colno), sizeof(binary));
+    return fromServerEpoch(static_cast<long>(be64toh(binary)));
+}
+
+template <>
+Numeric Row::get<Numeric> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+    return Numeric(decodeNumeric(PQgetvalue(res, rowno, colno), PQgetlength(res, rowno, colno)));
+}
+
+template <>
+Uuid Row::get<Uuid> (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+    assert(PQgetlength(res, rowno, colno) == sizeof(Uuid().bytes));
+
+    Uuid value;
+    memcpy(value.bytes, PQgetvalue(res, rowno, colno), sizeof(value.bytes));
+    return value;
+}
+
+template <>
+Bytea Row::get<Bytea> (int colno) {
+    return Bytea(get<std::string>(colno));
+}
+
+static uint32_t readUint32(const char* binary) {
+    uint32_t value;
+    memcpy(&value, binary, sizeof(value));
+    return be32toh(value);
+}
+
+/** reads elements of one dimensional array in binary format, `read` is called for each element
+  * with its binary representation and its length, -1 if the element is null */
+template <typename Reader>
+static void readArray(const char* binary, int size, Reader& read) {
+    const char* end = binary + size;
+
+    assert(size >= static_cast<int>(3*sizeof(uint32_t)));
+    int dimensions = static_cast<int>(readUint32(binary));
+    binary += 3*sizeof(uint32_t);
+
+    //empty array has no dimensions
+    if(dimensions == 0) {
+        return;
+    }
+    assert(dimensions == 1);
+
+    int count = static_cast<int>(readUint32(binary));
+    binary += 2*sizeof(uint32_t);
+    read.reserve(count);
+
+    //elements which do not fit in the value are not read
+    for(int i = 0; i < count && binary + sizeof(uint32_t) <= end; i++) {
+        int length = static_cast<int>(readUint32(binary));
+        binary += sizeof(uint32_t);
+
+        if(length > end - binary) {
+            break;
+        }
+
+        read(binary, length);
+        binary += length < 0 ? 0 : length;
+    }
+
+    assert(binary == end);
+}
+
+struct ReadInts {
+    std::vector<int>& values;
+    ReadInts(std::vector<int>& _values): values(_values) {}
+
+    void reserve(int count) { values.reserve(count); }
+    void operator()(const char* binary, int length) {
+        values.push_back(length < 0 ? 0 : static_cast<int>(readUint32(binary)));
+    }
+};
+
+struct ReadLongs {
+    std::vector<long>& values;
+    ReadLongs(std::vector<long>& _values): values(_values) {}
+
+    void reserve(int count) { values.reserve(count); }
+    void operator()(const char* binary, int length) {
+        uint64_t value = 0;
+        if(length >= 0) {
+            memcpy(&value, binary, sizeof(value));
+        }
+        values.push_back(static_cast<long>(be64toh(value)));
+    }
+};
+
+struct ReadStrings {
+    std::vector<std::string>& values;
+    ReadStrings(std::vector<std::string>& _values): values(_values) {}
+
+    void reserve(int count) { values.reserve(count); }
+    void operator()(const char* binary, int length) {
+        values.push_back(length < 0 ? std::string() : std::string(binary, length));
+    }
+};
+
+template <>
+std::vector<int> Row::get< std::vector<int> > (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+
+    std::vector<int> values;
+    ReadInts read(values);
+    readArray(PQgetvalue(res, rowno, colno), PQgetlength(res, rowno, colno), read);
+
+    return values;
+}
+
+template <>
+std::vector<long> Row::get< std::vector<long> > (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+
+    std::vector<long> values;
+    ReadLongs read(values);
+    readArray(PQgetvalue(res, rowno, colno), PQgetlength(res, rowno, colno), read);
+
+    return values;
+}
+
+template <>
+std::vector<std::string> Row::get< std::vector<std::string> > (int colno) {
+    assert(rowno < PQntuples(res));
+    assert(colno < PQnfields(res));
+
+    std::vector<std::string> values;
+    ReadStrings read(values);
+    readArray(PQgetvalue(res, rowno, colno), PQgetlength(res, rowno, colno), read);
+
+    return values;
+}
+
 }
 }
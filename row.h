@@ -8,6 +8,9 @@
 #include <netinet/in.h>
 #include <sstream>
 #include <iostream>
+#include "columnindex.h"
+#include "span.h"
+#include "datatypes.h"
 
 namespace nkdhny{
 namespace db{
@@ -16,9 +19,11 @@ namespace db{
 struct Row {
     int rowno;
     PGresult* res;
+    /** column numbers by name shared by rows of the result, `NULL` if names are resolved by `PQfnumber` */
+    ColumnIndex* columns;
 
 
-    Row(PGresult* _result, int _rowno = 0);
+    Row(PGresult* _result, int _rowno = 0, ColumnIndex* _columns = NULL);
 
     /** Typed get the content of the column of the result
       * One could define ones own specializations of this method to
@@ -33,11 +38,21 @@ struct Row {
       * @endverbatim
       * More general way is to load binary representation of object with `PQgetvalue`
       * and constract an object based on its binary representation
+      *
+      * One dimensional array of `int4`, `int8` or `text` is got as `std::vector` of `int`, `long`
+      * or `std::string`, null elements are got as `0` or empty string
+      *
+      * `text` or `bytea` value could be got without a copy as `Span` pointing into the result,
+      * it is valid as long as the result is
+      *
+      * `float4`, `float8`, `bool`, `timestamp`, `timestamptz`, `numeric`, `uuid` and `bytea` values are got as
+      * `float`, `double`, `bool`, `Timestamp`, `Numeric`, `Uuid` and `Bytea` (see `datatypes.h`)
       */
     template <typename _T>
     _T get(int);
 
-    /** gets the content of named column in a row*/
+    /** gets the content of named column in a row,
+      * for many rows consider to get column number once (see `Result::colno`) */
     template <typename _T>
     _T get(const std::string&);
 
@@ -53,7 +68,7 @@ struct Row {
 
 template <typename T>
 T Row::get(const std::string& colname) {
-    int colno = PQfnumber(res, colname.c_str());
+    int colno = columns != NULL ? columns->find(res, colname) : PQfnumber(res, colname.c_str());
     return get<T>(colno);
 }
 
@@ -0,0 +1,346 @@
+#ifndef ROWBINDER_H
+#define ROWBINDER_H
+
+#include <string>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+#include "assert.h"
+#include "row.h"
+#include "columnindex.h"
+#include "pgtypes.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Description of fields of `T` to be read from a row, to be specialized for each mapped type
+  * No generic definition is given. Specialization defines static `describe` method which binds
+  * each field of `T` to a column by name (see `RowBinder::field`), like this
+  * @verbatim
+  * struct Foo {
+  *     int id;
+  *     std::string name;
+  * };
+  *
+  * namespace nkdhny{
+  * namespace db{
+  * template <>
+  * struct RowTraits<Foo> {
+  *     static void describe(RowBinder<Foo>& binder) {
+  *         binder.field("id", &Foo::id).field("name", &Foo::name);
+  *     }
+  * };
+  * }}
+  * @endverbatim
+  * then rows of a result are read as `Foo` objects (see `Result::as`)
+  */
+template <typename T>
+struct RowTraits;
+
+/** Server types which values could be got as `M` by `Row::get`, any type is accepted unless specialized */
+template <typename M>
+struct ColumnType {
+    static bool accepts(Oid) {
+        return true;
+    }
+};
+
+template <>
+struct ColumnType<int> {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT4;
+    }
+};
+
+template <>
+struct ColumnType<unsigned> {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT4;
+    }
+};
+
+template <>
+struct ColumnType<long> {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT8;
+    }
+};
+
+template <>
+struct ColumnType<unsigned long> {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT8;
+    }
+};
+
+template <>
+struct ColumnType<long long> {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT8;
+    }
+};
+
+template <>
+struct ColumnType<std::string> {
+    static bool accepts(Oid type) {
+        return type == pgtype::TEXT || type == pgtype::VARCHAR || type == pgtype::BPCHAR || type == pgtype::BYTEA;
+    }
+};
+
+template <>
+struct ColumnType<Span> {
+    static bool accepts(Oid type) {
+        return ColumnType<std::string>::accepts(type);
+    }
+};
+
+template <>
+struct ColumnType<float> {
+    static bool accepts(Oid type) {
+        return type == pgtype::FLOAT4;
+    }
+};
+
+template <>
+struct ColumnType<double> {
+    static bool accepts(Oid type) {
+        return type == pgtype::FLOAT8;
+    }
+};
+
+template <>
+struct ColumnType<bool> {
+    static bool accepts(Oid type) {
+        return type == pgtype::BOOL;
+    }
+};
+
+template <>
+struct ColumnType<Timestamp> {
+    static bool accepts(Oid type) {
+        return type == pgtype::TIMESTAMP || type == pgtype::TIMESTAMPTZ;
+    }
+};
+
+template <>
+struct ColumnType<Numeric> {
+    static bool accepts(Oid type) {
+        return type == pgtype::NUMERIC;
+    }
+};
+
+template <>
+struct ColumnType<Uuid> {
+    static bool accepts(Oid type) {
+        return type == pgtype::UUID;
+    }
+};
+
+template <>
+struct ColumnType<Bytea> {
+    static bool accepts(Oid type) {
+        return type == pgtype::BYTEA;
+    }
+};
+
+template <>
+struct ColumnType< std::vector<int> > {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT4ARRAY;
+    }
+};
+
+template <>
+struct ColumnType< std::vector<long> > {
+    static bool accepts(Oid type) {
+        return type == pgtype::INT8ARRAY;
+    }
+};
+
+template <>
+struct ColumnType< std::vector<std::string> > {
+    static bool accepts(Oid type) {
+        return type == pgtype::TEXTARRAY;
+    }
+};
+
+/** field of `T` bound to a column */
+template <typename T>
+struct FieldBinding {
+    std::string name;
+    /** number of the column, -1 until bound to a result */
+    int colno;
+
+    explicit FieldBinding(const std::string& _name): name(_name), colno(-1) {}
+    virtual ~FieldBinding() {}
+
+    virtual bool accepts(Oid type) const = 0;
+    virtual void read(Row& row, T& object) const = 0;
+    virtual FieldBinding* clone() const = 0;
+};
+
+template <typename T, typename M>
+struct MemberBinding: public FieldBinding<T> {
+    M T::* member;
+
+    MemberBinding(const std::string& _name, M T::* _member): FieldBinding<T>(_name), member(_member) {}
+
+    bool accepts(Oid type) const {
+        return ColumnType<M>::accepts(type);
+    }
+
+    void read(Row& row, T& object) const {
+        object.*member = row.get<M>(this->colno);
+    }
+
+    FieldBinding<T>* clone() const {
+        return new MemberBinding(*this);
+    }
+};
+
+/** Reads rows of a result into objects of `T` as described by `RowTraits<T>`
+  * Columns are resolved by name and their types are checked once when binder is bound to a result,
+  * then each row is read field by field by column numbers
+  */
+template <typename T>
+class RowBinder
+{
+private:
+    std::vector<FieldBinding<T>*> fields;
+
+    void release() {
+        for(size_t i = 0; i < fields.size(); i++) {
+            delete fields[i];
+        }
+        fields.clear();
+    }
+
+public:
+    RowBinder() {
+        RowTraits<T>::describe(*this);
+    }
+
+    RowBinder(const RowBinder& other) {
+        for(size_t i = 0; i < other.fields.size(); i++) {
+            fields.push_back(other.fields[i]->clone());
+        }
+    }
+
+    const RowBinder& operator =(const RowBinder& other) {
+        if(this != &other) {
+            release();
+            for(size_t i = 0; i < other.fields.size(); i++) {
+                fields.push_back(other.fields[i]->clone());
+            }
+        }
+        return *this;
+    }
+
+    ~RowBinder() {
+        release();
+    }
+
+    /** binds `member` to the column named `colname` (see `Row::get(const std::string&)`) */
+    template <typename M>
+    RowBinder& field(const std::string& colname, M T::* member) {
+        fields.push_back(new MemberBinding<T, M>(colname, member));
+        return *this;
+    }
+
+    /** resolves columns of `result` with `columns` index and checks their types,
+      * returns false if a column is missing or is of a type its field could not be got as */
+    bool bind(PGresult* result, ColumnIndex& columns) {
+        bool matches = true;
+
+        for(size_t i = 0; i < fields.size(); i++) {
+            FieldBinding<T>* f = fields[i];
+            f->colno = columns.find(result, f->name);
+            matches = matches && f->colno >= 0 && f->accepts(PQftype(result, f->colno));
+        }
+
+        return matches;
+    }
+
+    /** reads `row` of a bound result into `object` */
+    void read(Row& row, T& object) const {
+        for(size_t i = 0; i < fields.size(); i++) {
+            fields[i]->read(row, object);
+        }
+    }
+};
+
+/** Rows of a result read as objects of `T` (see `Result::as`), valid as long as the result is
+  * Range of a result which columns do not match fields of `T` is empty (see `bound`)
+  */
+template <typename T>
+class RowRange
+{
+private:
+    PGresult* result;
+    ColumnIndex* columns;
+    RowBinder<T> binder;
+    bool matches;
+
+public:
+    class iterator {
+    private:
+        Row row;
+        const RowBinder<T>* binder;
+
+    public:
+        iterator(const Row& _row, const RowBinder<T>* _binder): row(_row), binder(_binder) {}
+
+        T operator *() {
+            T object;
+            binder->read(row, object);
+            return object;
+        }
+
+        /** reads current row into existing `object` */
+        void read(T& object) {
+            binder->read(row, object);
+        }
+
+        iterator& operator ++() {
+            ++row;
+            return *this;
+        }
+
+        bool operator ==(const iterator& other) const {
+            return row == other.row;
+        }
+
+        bool operator !=(const iterator& other) const {
+            return row != other.row;
+        }
+    };
+
+    RowRange(PGresult* _result, ColumnIndex* _columns):
+        result(_result),
+        columns(_columns),
+        binder(),
+        matches(binder.bind(result, *columns))
+    {}
+
+    /** false if a column of a field is missing or is of a type the field could not be got as,
+      * no row is read then */
+    bool bound() const {
+        return matches;
+    }
+
+    iterator begin() const {
+        return iterator(Row(result, 0, columns), &binder);
+    }
+
+    iterator end() const {
+        return iterator(Row(result, count(), columns), &binder);
+    }
+
+    int count() const {
+        return matches ? PQntuples(result) : 0;
+    }
+};
+
+}
+}
+
+#endif // ROWBINDER_H
@@ -0,0 +1,141 @@
+#include "result.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <endian.h>
+
+using namespace nkdhny::db;
+
+struct Account {
+  int id;
+  long balance;
+  std::string owner;
+};
+
+namespace nkdhny {
+namespace db {
+template <>
+struct RowTraits<Account> {
+  static void describe(RowBinder<Account>& binder) {
+    binder.field("id", &Account::id).field("balance", &Account::balance).field("owner", &Account::owner);
+  }
+};
+}
+}
+
+/** result made on the client side as it would be received in binary format */
+PGresult* makeResult(Oid balance_type, int rows) {
+  PGresult* result = PQmakeEmptyPGresult(NULL, PGRES_TUPLES_OK);
+
+  PGresAttDesc attributes[3];
+  memset(attributes, 0, sizeof(attributes));
+  attributes[0].name = const_cast<char*>("owner");
+  attributes[0].typid = pgtype::TEXT;
+  attributes[1].name = const_cast<char*>("id");
+  attributes[1].typid = pgtype::INT4;
+  attributes[2].name = const_cast<char*>("balance");
+  attributes[2].typid = balance_type;
+  for(int i = 0; i < 3; i++) {
+    attributes[i].format = 1;
+  }
+  PQsetResultAttrs(result, 3, attributes);
+
+  for(int i = 0; i < rows; i++) {
+    std::string owner(i + 1, 'a');
+    uint32_t id = htobe32(i);
+    uint64_t balance = htobe64(static_cast<uint64_t>(i) * 100);
+
+    PQsetvalue(result, i, 0, const_cast<char*>(owner.data()), owner.size());
+    PQsetvalue(result, i, 1, reinterpret_cast<char*>(&id), sizeof(id));
+    PQsetvalue(result, i, 2, reinterpret_cast<char*>(&balance), sizeof(balance));
+  }
+
+  return result;
+}
+
+TEST(RowBinderTest, shouldReadEachRowIntoObject) {
+  Result r(makeResult(pgtype::INT8, 3));
+  RowRange<Account> accounts = r.as<Account>();
+
+  EXPECT_TRUE(accounts.bound());
+  EXPECT_EQ(3, accounts.count());
+
+  int i = 0;
+  for(RowRange<Account>::iterator a = accounts.begin(); a != accounts.end(); ++a, ++i) {
+    Account account = *a;
+    EXPECT_EQ(i, account.id);
+    EXPECT_EQ(i * 100L, account.balance);
+    EXPECT_EQ(std::string(i + 1, 'a'), account.owner);
+  }
+  EXPECT_EQ(3, i);
+}
+
+TEST(RowBinderTest, shouldResolveColumnsOnce) {
+  PGresult* result = makeResult(pgtype::INT8, 1);
+  ColumnIndex columns;
+  RowBinder<Account> binder;
+
+  ASSERT_TRUE(binder.bind(result, columns));
+
+  Account account;
+  Row row(result, 0, &columns);
+  binder.read(row, account);
+  EXPECT_EQ(0, account.id);
+  EXPECT_EQ("a", account.owner);
+
+  PQclear(result);
+}
+
+TEST(RowBinderTest, shouldRejectColumnOfOtherType) {
+  PGresult* result = makeResult(pgtype::INT4, 1);
+  ColumnIndex columns;
+  RowBinder<Account> binder;
+
+  EXPECT_FALSE(binder.bind(result, columns));
+
+  PQclear(result);
+}
+
+TEST(RowBinderTest, shouldRejectMissingColumn) {
+  PGresult* result = PQmakeEmptyPGresult(NULL, PGRES_TUPLES_OK);
+  ColumnIndex columns;
+  RowBinder<Account> binder;
+
+  EXPECT_FALSE(binder.bind(result, columns));
+
+  PQclear(result);
+}
+
+TEST(RowBinderTest, shouldReadNoRowWhenColumnIsOfOtherType) {
+  Result r(makeResult(pgtype::INT4, 3));
+  RowRange<Account> accounts = r.as<Account>();
+
+  EXPECT_FALSE(accounts.bound());
+  EXPECT_EQ(0, accounts.count());
+  EXPECT_TRUE(accounts.begin() == accounts.end());
+}
+
+TEST(RowBinderTest, shouldReadNoRowWhenColumnIsMissing) {
+  PGresult* result = PQmakeEmptyPGresult(NULL, PGRES_TUPLES_OK);
+
+  PGresAttDesc attribute;
+  memset(&attribute, 0, sizeof(attribute));
+  attribute.name = const_cast<char*>("id");
+  attribute.typid = pgtype::INT4;
+  attribute.format = 1;
+  PQsetResultAttrs(result, 1, &attribute);
+
+  uint32_t id = htobe32(1);
+  PQsetvalue(result, 0, 0, reinterpret_cast<char*>(&id), sizeof(id));
+
+  Result r(result);
+  RowRange<Account> accounts = r.as<Account>();
+
+  EXPECT_FALSE(accounts.bound());
+  EXPECT_EQ(0, accounts.count());
+  EXPECT_TRUE(accounts.begin() == accounts.end());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,63 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <string>
+#include <ostream>
+#include <string.h>
+
+namespace nkdhny {
+namespace db {
+
+/** Bytes of a value which are owned by someone else, like a cell of a result (see `Row::get<Span>`)
+  * Span is valid as long as its owner is, it could hold any bytes including zeroes thus
+  * it is suitable for both `text` and `bytea` values
+  */
+struct Span {
+    const char* data;
+    int size;
+
+    Span(): data(""), size(0) {}
+    Span(const char* _data, int _size): data(_data), size(_size) {}
+
+    bool empty() const {
+        return size == 0;
+    }
+
+    const char* begin() const {
+        return data;
+    }
+
+    const char* end() const {
+        return data + size;
+    }
+
+    /** copy of the bytes */
+    std::string str() const {
+        return std::string(data, size);
+    }
+
+    bool operator ==(const Span& other) const {
+        return size == other.size && memcmp(data, other.data, size) == 0;
+    }
+
+    bool operator !=(const Span& other) const {
+        return !(*this == other);
+    }
+
+    bool operator ==(const std::string& other) const {
+        return *this == Span(other.data(), other.size());
+    }
+
+    bool operator !=(const std::string& other) const {
+        return !(*this == other);
+    }
+};
+
+inline std::ostream& operator <<(std::ostream& out, const Span& span) {
+    return out.write(span.data, span.size);
+}
+
+}
+}
+
+#endif // SPAN_H
@@ -0,0 +1,253 @@
+#include "statementcache.h"
+#include "atomic.h"
+#include <sstream>
+#include <assert.h>
+
+namespace nkdhny {
+namespace db {
+
+PreparedStatement::PreparedStatement():
+  name(),
+  parameters()
+{}
+
+PreparedStatement::PreparedStatement(const std::string &_name):
+  name(_name),
+  parameters()
+{}
+
+bool PreparedStatement::prepare(PGconn *connection, const std::string &sql, int count, const Oid *types)
+{
+  PGresult* prepared_result = PQprepare(connection, name.c_str(), sql.c_str(), count, types);
+  bool ok = PQresultStatus(prepared_result) == PGRES_COMMAND_OK;
+  PQclear(prepared_result);
+
+  return ok && describe(connection);
+}
+
+bool PreparedStatement::describe(PGconn *connection)
+{
+  PGresult* description = PQdescribePrepared(connection, name.c_str());
+  bool ok = PQresultStatus(description) == PGRES_COMMAND_OK;
+
+  parameters.clear();
+  if(ok) {
+    for(int i = 0; i < PQnparams(description); i++) {
+      parameters.push_back(PQparamtype(description, i));
+    }
+  }
+
+  PQclear(description);
+  return ok;
+}
+
+bool PreparedStatement::accepts(ParamBuilder &bound) const
+{
+  if(bound.count() != static_cast<int>(parameters.size())) {
+    return false;
+  }
+
+  const Oid* types = bound.types();
+  const int* formats = bound.formats();
+
+  for(size_t i = 0; i < parameters.size(); i++) {
+    if(formats[i] == Parameter::BINARY_FORMAT && types[i] != pgtype::UNSPECIFIED && types[i] != parameters[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const int StatementCache::DEFAULT_CAPACITY = 128;
+
+volatile int StatementCache::capacity = StatementCache::DEFAULT_CAPACITY;
+
+StatementCache::Statements::Statements():
+  prepared(),
+  used(),
+  executions(),
+  sequence(0)
+{}
+
+StatementCache::Statements* StatementCache::statements(PGconn *connection)
+{
+  Statements* s = static_cast<Statements*>(PQinstanceData(connection, events));
+  if(s != NULL) {
+    return s;
+  }
+
+  //registration fails if the procedure is already registered, i.e. statements were purged, instance data is set anyway
+  PQregisterEventProc(connection, events, "richquery statements", NULL);
+
+  s = new Statements();
+  if(PQsetInstanceData(connection, events, s) != 1) {
+    //statements could not be attached, thus are not cached and queries are executed as is
+    delete s;
+    return NULL;
+  }
+  return s;
+}
+
+int StatementCache::events(PGEventId id, void *info, void *)
+{
+  PGconn* connection = NULL;
+
+  switch(id) {
+  case PGEVT_CONNRESET:
+    connection = static_cast<PGEventConnReset*>(info)->conn;
+    break;
+  case PGEVT_CONNDESTROY:
+    connection = static_cast<PGEventConnDestroy*>(info)->conn;
+    break;
+  default:
+    return 1;
+  }
+
+  delete static_cast<Statements*>(PQinstanceData(connection, events));
+  PQsetInstanceData(connection, events, NULL);
+  return 1;
+}
+
+std::string StatementCache::key(const std::string &sql, int count, const Oid *types)
+{
+  std::ostringstream key;
+  key << sql;
+
+  //statement prepared with no types keeps the text as its key
+  for(int i = 0; i < count; i++) {
+    key << (i == 0 ? '\0' : ',') << types[i];
+  }
+
+  return key.str();
+}
+
+const PreparedStatement* StatementCache::find(Statements *s, const std::string &key)
+{
+  std::map<std::string, Statement>::iterator found = s->prepared.find(key);
+  if(found == s->prepared.end()) {
+    return NULL;
+  }
+
+  s->used.splice(s->used.begin(), s->used, found->second.used);
+  return &found->second.prepared;
+}
+
+const PreparedStatement* StatementCache::find(PGconn *connection, const std::string &sql)
+{
+  Statements* s = statements(connection);
+  return s == NULL ? NULL : find(s, sql);
+}
+
+const PreparedStatement* StatementCache::find(PGconn *connection, const std::string &sql, ParamBuilder &parameters)
+{
+  Statements* s = statements(connection);
+  if(s == NULL) {
+    return NULL;
+  }
+
+  const PreparedStatement* typed = find(s, key(sql, parameters.count(), parameters.types()));
+  if(typed != NULL) {
+    return typed;
+  }
+
+  //statement prepared by the text alone, e.g. by a `QueryTemplate`, binds the parameters the same way if it accepts them
+  const PreparedStatement* untyped = find(s, sql);
+  return untyped != NULL && untyped->accepts(parameters) ? untyped : NULL;
+}
+
+const PreparedStatement* StatementCache::prepare(PGconn *connection, const std::string &sql)
+{
+  return prepare(connection, sql, 0, NULL);
+}
+
+const PreparedStatement* StatementCache::prepare(PGconn *connection, const std::string &sql, ParamBuilder &parameters)
+{
+  return prepare(connection, sql, parameters.count(), parameters.types());
+}
+
+const PreparedStatement* StatementCache::prepare(PGconn *connection, const std::string &sql, int count, const Oid *types)
+{
+  Statements* s = statements(connection);
+  if(s == NULL) {
+    return NULL;
+  }
+
+  std::string k = key(sql, count, types);
+
+  const PreparedStatement* found = find(s, k);
+  if(found != NULL) {
+    return found;
+  }
+
+  while(static_cast<int>(s->prepared.size()) >= atomicGet(capacity) && !s->used.empty()) {
+    evict(connection, s);
+  }
+
+  std::stringstream name;
+  name << "richquery_" << ++s->sequence;
+
+  Statement statement;
+  statement.prepared.name = name.str();
+
+  if(!statement.prepared.prepare(connection, sql, count, types)) {
+    return NULL;
+  }
+
+  s->used.push_front(k);
+  statement.used = s->used.begin();
+  s->executions.erase(sql);
+
+  return &(s->prepared[k] = statement).prepared;
+}
+
+void StatementCache::evict(PGconn *connection, Statements *s)
+{
+  std::map<std::string, Statement>::iterator victim = s->prepared.find(s->used.back());
+
+  //statement is forgotten even if deallocation failed, e.g. in aborted transaction, names are not reused anyway
+  std::string deallocate = "deallocate " + victim->second.prepared.name;
+  PQclear(PQexec(connection, deallocate.c_str()));
+
+  s->prepared.erase(victim);
+  s->used.pop_back();
+}
+
+int StatementCache::executed(PGconn *connection, const std::string &sql)
+{
+  Statements* s = statements(connection);
+  if(s == NULL) {
+    return 0;
+  }
+
+  if(static_cast<int>(s->executions.size()) >= atomicGet(capacity) && s->executions.find(sql) == s->executions.end()) {
+    s->executions.clear();
+  }
+
+  return ++s->executions[sql];
+}
+
+void StatementCache::purge(PGconn *connection)
+{
+  Statements* s = static_cast<Statements*>(PQinstanceData(connection, events));
+  if(s != NULL) {
+    delete s;
+    PQsetInstanceData(connection, events, NULL);
+  }
+}
+
+int StatementCache::count(PGconn *connection)
+{
+  Statements* s = statements(connection);
+  return s == NULL ? 0 : s->prepared.size();
+}
+
+void StatementCache::setCapacity(int _capacity)
+{
+  assert(_capacity > 0);
+  capacity = _capacity;
+  __sync_synchronize();
+}
+
+}
+}
@@ -0,0 +1,124 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <string>
+#include <map>
+#include <list>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+#include <postgresql/libpq-events.h>
+#include "lock.h"
+#include "parambuilder.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Statement prepared on a connection
+  * Types of its parameters are described by the server once when the statement is prepared,
+  * thus parameters bound to the statement are checked without a round trip
+  */
+struct PreparedStatement {
+  std::string name;
+  /** OIDs of types of parameters */
+  std::vector<Oid> parameters;
+
+  PreparedStatement();
+  explicit PreparedStatement(const std::string& _name);
+
+  /** prepares `sql` on `connection` under my name and describes it, returns false if either failed,
+    * types of `count` parameters are given by `types` (see `ParamBuilder::types`), the server infers the rest */
+  bool prepare(PGconn* connection, const std::string& sql, int count = 0, const Oid* types = NULL);
+  /** describes statement already prepared on `connection` under my name, returns false if failed */
+  bool describe(PGconn* connection);
+
+  /** checks that count of `bound` parameters is the count of my parameters
+    * and that binary ones of known type are of the same types */
+  bool accepts(ParamBuilder& bound) const;
+};
+
+/** Statements prepared on each connection, shared by all `QueryTemplate` and `Query` objects
+  * Each connection prepares a query text once under a generated name, the name is found by the text later on,
+  * thus statement outlives objects that prepared it and the connection could be borrowed from a pool
+  * many times with its statements ready.
+  * Text prepared for bound parameters is prepared with their types and is found by the text and the types,
+  * thus parameters are bound to the statement the same way they are bound to the text which is not prepared.
+  * At most `capacity` statements are kept per connection, preparing one more deallocates the least recently used one.
+  *
+  * Statements of a connection are kept as instance data of a libpq event procedure registered on the connection,
+  * so they are found without any process wide lock and are freed by libpq when the connection is finished
+  * (or forgotten when it is reset, as the server drops them too).
+  * If statements could not be attached to a connection nothing is cached for it, thus queries on it are not prepared.
+  *
+  * Statements of a connection are not locked as a connection is used by a single thread at a time
+  */
+class StatementCache
+{
+public:
+  static const int DEFAULT_CAPACITY;
+
+  /** statement prepared for `sql` on `connection`, the statement is prepared if it was not,
+    * `NULL` if `sql` could not be prepared. Statement is valid until it is evicted or purged */
+  static const PreparedStatement* prepare(PGconn* connection, const std::string& sql);
+
+  /** statement prepared for `sql` on `connection`, `NULL` if it was not */
+  static const PreparedStatement* find(PGconn* connection, const std::string& sql);
+
+  /** statement prepared for `sql` with types of `parameters` on `connection` (see `prepare` below),
+    * or the one prepared for `sql` alone if it accepts `parameters`, `NULL` if there is none */
+  static const PreparedStatement* find(PGconn* connection, const std::string& sql, ParamBuilder& parameters);
+
+  /** statement prepared for `sql` with types of `parameters` on `connection`, thus the parameters are bound
+    * the same way they would be bound to `sql` which is not prepared, the statement is prepared if it was not,
+    * `NULL` if `sql` could not be prepared. Statement is valid until it is evicted or purged */
+  static const PreparedStatement* prepare(PGconn* connection, const std::string& sql, ParamBuilder& parameters);
+
+  /** counts one more execution of not prepared `sql` on `connection`, returns count of executions so far
+    * (see `Query`), no more than `capacity` texts are counted per connection */
+  static int executed(PGconn* connection, const std::string& sql);
+
+  /** forgets statements of `connection`, libpq forgets them itself when the connection is finished or reset */
+  static void purge(PGconn* connection);
+
+  /** count of statements prepared on `connection` */
+  static int count(PGconn* connection);
+
+  /** maximum count of statements per connection, `DEFAULT_CAPACITY` by default */
+  static void setCapacity(int capacity);
+
+private:
+  struct Statement {
+    PreparedStatement prepared;
+    /** position in `Statements::used` */
+    std::list<std::string>::iterator used;
+  };
+
+  struct Statements {
+    /** statements by their keys (see `key`) */
+    std::map<std::string, Statement> prepared;
+    /** keys of prepared statements, most recently used first */
+    std::list<std::string> used;
+    std::map<std::string, int> executions;
+    long sequence;
+
+    Statements();
+  };
+
+  static volatile int capacity;
+
+  /** libpq event procedure owning `Statements` of a connection */
+  static int events(PGEventId id, void* info, void* passThrough);
+
+  static Statements* statements(PGconn* connection);
+  /** key of a statement prepared for `sql` with `count` parameters of `types` */
+  static std::string key(const std::string& sql, int count, const Oid* types);
+  static const PreparedStatement* find(Statements* s, const std::string& key);
+  static const PreparedStatement* prepare(PGconn* connection, const std::string& sql, int count, const Oid* types);
+  static void evict(PGconn* connection, Statements* s);
+
+  StatementCache();
+};
+
+}
+}
+
+#endif // STATEMENTCACHE_H
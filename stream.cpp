@@ -0,0 +1,149 @@
+#include "stream.h"
+
+namespace nkdhny {
+namespace db {
+
+Stream::Stream(PGconn *_connection, const std::string &_sql, int _chunk_size):
+    connection(_connection),
+    sql(_sql),
+    parameters(),
+    chunk_size(_chunk_size),
+    started(false),
+    finished(false),
+    chunk(NULL),
+    rowno(0),
+    rows(0),
+    final_status(PGRES_EMPTY_QUERY),
+    columns()
+{
+    assert(chunk_size > 0);
+}
+
+Stream::~Stream()
+{
+    release();
+
+    if(started && !finished) {
+        cancel();
+    }
+}
+
+void Stream::cancel()
+{
+    //the rest of the rows is not to be transfered
+    PGcancel* request = PQgetCancel(connection);
+    if(request != NULL) {
+        char error[256];
+        PQcancel(request, error, sizeof(error));
+        PQfreeCancel(request);
+    }
+
+    PGresult* r = NULL;
+    while((r = PQgetResult(connection)) != NULL) {
+        PQclear(r);
+    }
+}
+
+void Stream::start()
+{
+    started = true;
+
+    const PreparedStatement* statement = StatementCache::find(connection, sql, parameters);
+
+    int sent = statement == NULL ?
+        PQsendQueryParams(connection, sql.c_str(), parameters.count(), parameters.types(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1) :
+        PQsendQueryPrepared(connection, statement->name.c_str(), parameters.count(), parameters.values(), parameters.sizes(), parameters.formats(), /*binary*/ 1);
+    parameters.clear();
+
+    if(sent != 1) {
+        final_status = PGRES_FATAL_ERROR;
+        finished = true;
+        return;
+    }
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    int mode = chunk_size > 1 ? PQsetChunkedRowsMode(connection, chunk_size) : PQsetSingleRowMode(connection);
+#else
+    int mode = PQsetSingleRowMode(connection);
+#endif
+
+    //all rows would be buffered at once otherwise
+    if(mode != 1) {
+        cancel();
+        final_status = PGRES_FATAL_ERROR;
+        finished = true;
+    }
+}
+
+void Stream::release()
+{
+    if(chunk != NULL) {
+        PQclear(chunk);
+        chunk = NULL;
+    }
+}
+
+bool Stream::next()
+{
+    if(!started) {
+        start();
+    }
+
+    if(chunk != NULL && ++rowno < PQntuples(chunk)) {
+        ++rows;
+        return true;
+    }
+
+    release();
+
+    while(!finished) {
+        PGresult* r = PQgetResult(connection);
+
+        if(r == NULL) {
+            finished = true;
+            break;
+        }
+
+        ExecStatusType s = PQresultStatus(r);
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        bool rows_chunk = s == PGRES_SINGLE_TUPLE || s == PGRES_TUPLES_CHUNK;
+#else
+        bool rows_chunk = s == PGRES_SINGLE_TUPLE;
+#endif
+
+        if(rows_chunk && PQntuples(r) > 0) {
+            chunk = r;
+            rowno = 0;
+            ++rows;
+            return true;
+        }
+
+        //the final result has no rows, it only tells whether the query succeeded
+        if(!rows_chunk) {
+            final_status = s;
+        }
+        PQclear(r);
+    }
+
+    return false;
+}
+
+Row Stream::row()
+{
+    assert(chunk != NULL);
+    return Row(chunk, rowno, &columns);
+}
+
+long Stream::count()
+{
+    return rows;
+}
+
+ExecStatusType Stream::status()
+{
+    assert(finished);
+    return final_status;
+}
+
+}
+}
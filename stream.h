@@ -0,0 +1,93 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <string>
+#include <postgresql/libpq-fe.h>
+#include "parambuilder.h"
+#include "row.h"
+#include "statementcache.h"
+
+namespace nkdhny {
+namespace db {
+
+/** Result of a query read from the server row by row while the query is still running
+  * thus only the current chunk of rows is kept in memory and the first row is available
+  * after a single round trip
+  * @verbatim
+  *     Stream s(connection, "select id, name from foo where id > $1");
+  *     s.pushParameter(0);
+  *     while(s.next()) {
+  *         Row r = s.row();
+  *         r.get<int>("id");
+  *     }
+  * @endverbatim
+  * Rows are read in chunks of `chunk_size` rows if libpq supports chunked mode (libpq 17 and later)
+  * and one by one in single row mode otherwise. Row given by `row` is valid until the next call of `next`.
+  *
+  * Query which rows could not be streamed is cancelled and fails (see `status`).
+  *
+  * Connection is not to be used by other queries until all rows are read or the stream is destroyed,
+  * stream destroyed before the last row is read cancels its query.
+  * Stream is not copyable and is not to be shared between threads
+  */
+class Stream
+{
+private:
+    PGconn* connection;
+    std::string sql;
+    ParamBuilder parameters;
+    int chunk_size;
+
+    bool started;
+    bool finished;
+    /** current chunk of rows */
+    PGresult* chunk;
+    int rowno;
+    long rows;
+    ExecStatusType final_status;
+    /** columns are the same for all chunks */
+    ColumnIndex columns;
+
+    Stream(const Stream&);
+    const Stream& operator =(const Stream&);
+
+    void start();
+    void release();
+    /** stops the query before all rows are read and discards its results */
+    void cancel();
+
+public:
+    Stream(PGconn* _connection, const std::string& _sql, int _chunk_size = 256);
+    /** cancels the query if not all rows are read */
+    ~Stream();
+
+    /** @brief bind parameter of type `T` with value `value`
+      * to a subsequent query parameter. See `ParamBuilder` on
+      * how to extend this to User Defined Datatypes */
+    template <typename T>
+    Stream& pushParameter(T value);
+
+    /** moves to the next row, the query is sent on the first call,
+      * returns false when there are no more rows or the query failed (see `status`) */
+    bool next();
+
+    /** current row */
+    Row row();
+
+    /** count of rows read so far */
+    long count();
+
+    /** status of the query once all rows are read, `PGRES_TUPLES_OK` if it succeeded */
+    ExecStatusType status();
+};
+
+template <typename T>
+Stream& Stream::pushParameter(T value) {
+    parameters.push<T>(value);
+    return *this;
+}
+
+}
+}
+
+#endif // STREAM_H
@@ -0,0 +1,71 @@
+#include "stream.h"
+#include "querytemplate.h"
+#include <gtest/gtest.h>
+#include "connection.h"
+#include "row.h"
+
+using namespace nkdhny::db;
+
+PGconn * getConnection() {
+
+        PGconn *conn = NULL;
+        conn = PQconnectdb("user=\'credentials\' password=\'credentials\' dbname=\'richquery\' hostaddr=\'127.0.0.1\' port=\'5432\' connect_timeout=5");
+        assert(conn != NULL);
+        assert(PQstatus(conn) == CONNECTION_OK);
+        return conn;
+}
+
+TEST(StreamTest, MustReadAllRowsInOrder) {
+    Connection<> c(getConnection());
+    Stream s(c, "select i::int as _int, i::text as _text from generate_series(1, $1) as i");
+    s.pushParameter(1000);
+
+    int expected = 0;
+    while(s.next()) {
+        ++expected;
+        Row r = s.row();
+        EXPECT_EQ(r.get<int>("_int"), expected);
+        EXPECT_EQ(r.get<int>(0), expected);
+    }
+
+    EXPECT_EQ(expected, 1000);
+    EXPECT_EQ(s.count(), 1000);
+    EXPECT_EQ(s.status(), PGRES_TUPLES_OK);
+}
+
+TEST(StreamTest, MustFinishEmptyResult) {
+    Connection<> c(getConnection());
+    Stream s(c, "select 1::int as _int where false", 1);
+
+    EXPECT_FALSE(s.next());
+    EXPECT_EQ(s.count(), 0);
+    EXPECT_EQ(s.status(), PGRES_TUPLES_OK);
+}
+
+TEST(StreamTest, MustReportFailureAfterRowsRead) {
+    Connection<> c(getConnection());
+    Stream s(c, "select 1/(3 - i)::int as _int from generate_series(1, 5) as i", 1);
+
+    while(s.next()) {}
+
+    EXPECT_EQ(s.count(), 2);
+    EXPECT_EQ(s.status(), PGRES_FATAL_ERROR);
+}
+
+TEST(StreamTest, MustLeaveConnectionUsableWhenStoppedEarly) {
+    Connection<> c(getConnection());
+
+    {
+        Stream s(c, "select i::int as _int from generate_series(1, 10000000) as i");
+        EXPECT_TRUE(s.next());
+        EXPECT_EQ(s.row().get<int>("_int"), 1);
+    }
+
+    QueryTemplate q(c, "select 2::int as _int");
+    EXPECT_EQ(q().begin().get<int>("_int"), 2);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
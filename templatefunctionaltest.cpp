@@ -157,6 +157,84 @@ TEST(QueryTemplateTest, MustBeCommited) {
     drop();
 }
 
+TEST(QueryTemplateTest, MustPrepareQueryOncePerConnection) {
+
+    Connection<> c(getConnection());
+
+    {
+        QueryTemplate first(c, "select $1::int as _int;");
+        QueryTemplate second(c, "select $1::int as _int;");
+
+        second.pushParameter(7);
+        Result result = second();
+        EXPECT_EQ(result.begin().get<int>("_int"), 7);
+    }
+
+    QueryTemplate count(c, "select count(*)::int as _int from pg_prepared_statements;");
+    EXPECT_EQ(StatementCache::count(c), 2);
+    EXPECT_EQ(count().begin().get<int>("_int"), 2);
+}
+
+TEST(QueryTemplateTest, MustDeallocateLeastRecentlyUsedStatement) {
+
+    StatementCache::setCapacity(2);
+    Connection<> c(getConnection());
+
+    QueryTemplate first(c, "select 1 as _int;");
+    QueryTemplate second(c, "select 2 as _int;");
+    first();
+    QueryTemplate third(c, "select 3 as _int;");
+
+    EXPECT_EQ(StatementCache::count(c), 2);
+
+    //evicted statement is prepared again
+    Result result = second();
+    EXPECT_EQ(result.begin().get<int>("_int"), 2);
+    EXPECT_EQ(StatementCache::count(c), 2);
+
+    StatementCache::setCapacity(StatementCache::DEFAULT_CAPACITY);
+}
+
+TEST(QueryTemplateTest, MustDescribeParametersOnceWhenPrepared) {
+
+    Connection<> c(getConnection());
+
+    const PreparedStatement* statement = StatementCache::prepare(c, "select $1::int as _int, $2::bigint as _long, $3::text as _str;");
+    ASSERT_TRUE(statement != NULL);
+    ASSERT_EQ(statement->parameters.size(), 3);
+    EXPECT_EQ(statement->parameters[0], pgtype::INT4);
+    EXPECT_EQ(statement->parameters[1], pgtype::INT8);
+    EXPECT_EQ(statement->parameters[2], pgtype::TEXT);
+
+    ParamBuilder bound;
+    bound.push<int>(1);
+    bound.push<long>(2);
+    EXPECT_FALSE(statement->accepts(bound));
+
+    bound.push<std::string>("text");
+    EXPECT_TRUE(statement->accepts(bound));
+
+    bound.clear();
+    bound.push<long>(1);
+    bound.push<long>(2);
+    bound.push<std::string>("text");
+    EXPECT_FALSE(statement->accepts(bound));
+}
+
+TEST(QueryTemplateTest, MustExecuteQueryWhichCouldNotBePrepared) {
+
+    Connection<> c(getConnection());
+
+    QueryTemplate broken(c, "select * from there_is_no_such_table");
+    Result r = broken();
+
+    EXPECT_EQ(r.count(), 0);
+    EXPECT_EQ(StatementCache::count(c), 0);
+
+    QueryTemplate named(c, "select * from there_is_no_such_table", "broken_statement");
+    EXPECT_EQ(named().count(), 0);
+}
+
 int main(int argc, char **argv) {
 
   srand (time(NULL));
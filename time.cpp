@@ -1,4 +1,5 @@
 #include "time.h"
+#include <time.h>
 
 namespace nkdhny{
 
@@ -12,4 +13,12 @@ long gettime_ms(){
   return stamp_ms;
 }
 
+long gettime_us(){
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 }
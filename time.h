@@ -6,6 +6,8 @@
 namespace nkdhny {
 
 long gettime_ms();
+/** monotonic time in microseconds, to measure durations */
+long gettime_us();
 
 }
 